@@ -14,18 +14,113 @@
 
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <list>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 #include <cctype>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <iostream>
+#include <stdexcept>
 using namespace std;
 
+// Expression parsed once: the sum of its literals plus a list of signed variable terms.
+// Parsing failures are remembered so that evaluation can return 0 without rescanning the text.
+struct ParsedExpression
+{
+  bool valid{ true };
+  int constant{ 0 };
+  vector<pair<char, int>> terms; // variable name and sign (+1 / -1)
+};
+
+// Bounded LRU cache of parsed expressions keyed by expression text, safe to share between threads.
+// Entries are handed out as shared pointers so a hit never copies the parsed form.
+class ParsedExpressionCache
+{
+public:
+  struct Stats
+  {
+    size_t hits{ 0 }, misses{ 0 }, evictions{ 0 };
+  };
+
+  explicit ParsedExpressionCache(size_t capacity) : capacity(capacity) {}
+
+  template <typename Parser>
+  shared_ptr<const ParsedExpression> get(const string& expression, Parser parse)
+  {
+    {
+      lock_guard<mutex> lock(mtx);
+      auto it = index.find(expression);
+      if (it != index.end()) {
+        ++stats.hits;
+        entries.splice(entries.begin(), entries, it->second); // Mark as most recently used
+        return it->second->second;
+      }
+      ++stats.misses;
+    }
+
+    // Parse outside the lock; two threads missing on the same text both parse, the first one wins
+    auto parsed = make_shared<const ParsedExpression>(parse(expression));
+    if (capacity == 0)
+      return parsed;
+
+    lock_guard<mutex> lock(mtx);
+    auto it = index.find(expression);
+    if (it != index.end())
+      return it->second->second;
+
+    entries.emplace_front(expression, parsed);
+    index.emplace(expression, entries.begin());
+    if (entries.size() > capacity) {
+      index.erase(entries.back().first);
+      entries.pop_back();
+      ++stats.evictions;
+    }
+    return parsed;
+  }
+
+  Stats get_stats() const
+  {
+    lock_guard<mutex> lock(mtx);
+    return stats;
+  }
+
+  size_t size() const
+  {
+    lock_guard<mutex> lock(mtx);
+    return entries.size();
+  }
+
+private:
+  using Entry = pair<string, shared_ptr<const ParsedExpression>>;
+
+  const size_t capacity;
+  mutable mutex mtx;
+  list<Entry> entries; // Most recently used first
+  unordered_map<string, list<Entry>::iterator> index;
+  Stats stats;
+};
+
 struct ExpressionProcessor
 {
   map<char, int> variables;
 
-  int calculate(const string& expression)
+  // Copies share one cache: it is keyed by expression text only and safe to use from several threads
+  ExpressionProcessor(size_t cacheCapacity = 512) : cache(make_shared<ParsedExpressionCache>(cacheCapacity)) {}
+
+  // Tables smaller than this are evaluated on the calling thread only
+  static constexpr size_t parallel_threshold = 1 << 16;
+
+  static ParsedExpression parse(const string& expression)
   {
-    int result = 0;
+    ParsedExpression parsed;
     char op = '+';
-    bool isVariable = false;
 
     for (size_t i = 0; i < expression.size(); ++i) {
       char currentChar = expression[i];
@@ -37,39 +132,246 @@ struct ExpressionProcessor
           ++i;
         }
         --i;
-        if (op == '+')
-          result += num;
-        else if (op == '-')
-          result -= num;
-        else
-          result = num; // if there's only one digit in the expression
+        parsed.constant += op == '+' ? num : -num;
       }
       else if (isalpha(currentChar)) {
-        if (variables.find(currentChar) != variables.end()) {
-          if (op == '+')
-            result += variables[currentChar];
-          else if (op == '-')
-            result -= variables[currentChar];
-          else
-            result = variables[currentChar]; // if there's only one variable in the expression
-        }
-        else {
-          return 0; // Variable not found, return 0
-        }
+        parsed.terms.emplace_back(currentChar, op == '+' ? 1 : -1);
       }
       else if (currentChar == '+' || currentChar == '-') {
         op = currentChar;
       }
       else {
-        return 0; // Invalid character, return 0
+        parsed.valid = false; // Invalid character, evaluates to 0
+        return parsed;
       }
+    }
+
+    return parsed;
+  }
+
+  int evaluate(const ParsedExpression& parsed) const
+  {
+    if (!parsed.valid)
+      return 0;
+
+    int result = parsed.constant;
+    for (const auto& term : parsed.terms) {
+      auto it = variables.find(term.first);
+      if (it == variables.end())
+        return 0; // Variable not found, return 0
+      result += term.second * it->second;
+    }
+
+    return result;
+  }
+
+  int calculate(const string& expression)
+  {
+    return evaluate(*parse_cached(expression));
+  }
 
-      if (currentChar == '-' || currentChar == '+')
-        isVariable = false;
-      else
-        isVariable = true;
+  ParsedExpressionCache::Stats cache_stats() const
+  {
+    return cache->get_stats();
+  }
+
+  // Evaluates one expression against `rows` bindings at once. Each variable is a column of ints
+  // (columns[x][row]); variables without a column fall back to `variables` and are folded into the
+  // constant. A variable found in neither makes the whole result column 0, as in calculate().
+  // A referenced column shorter than `rows` is an error.
+  vector<int> calculate_batch(const string& expression, const map<char, vector<int>>& columns, size_t rows) const
+  {
+    vector<int> result(rows, 0);
+    auto parsed = parse_cached(expression); // keeps the entry alive if the cache evicts it meanwhile
+    if (!parsed->valid)
+      return result;
+
+    int constant = parsed->constant;
+    vector<pair<const int*, int>> columnTerms;
+    for (const auto& term : parsed->terms) {
+      auto column = columns.find(term.first);
+      if (column != columns.end()) {
+        if (column->second.size() < rows)
+          throw invalid_argument(string("column '") + term.first + "' has fewer than " + to_string(rows) + " rows");
+        columnTerms.emplace_back(column->second.data(), term.second);
+        continue;
+      }
+      auto it = variables.find(term.first);
+      if (it == variables.end())
+        return result; // Variable not found, return 0
+      constant += term.second * it->second;
     }
 
+    const size_t threadCount = rows < parallel_threshold ? 1 : max<size_t>(1, thread::hardware_concurrency());
+    const size_t chunk = (rows + threadCount - 1) / threadCount;
+
+    auto evaluateRange = [&](size_t begin, size_t end) {
+      int* out = result.data();
+      fill(out + begin, out + end, constant);
+      for (const auto& term : columnTerms) {
+        if (term.second > 0)
+          add_column(out, term.first, begin, end);
+        else
+          sub_column(out, term.first, begin, end);
+      }
+    };
+
+    vector<thread> threads;
+    for (size_t t = 1; t < threadCount && t * chunk < rows; ++t)
+      threads.emplace_back(evaluateRange, t * chunk, min(rows, (t + 1) * chunk));
+    evaluateRange(0, min(rows, chunk));
+    for (auto& th : threads)
+      th.join();
+
     return result;
   }
+
+private:
+  shared_ptr<ParsedExpressionCache> cache;
+
+  shared_ptr<const ParsedExpression> parse_cached(const string& expression) const
+  {
+    return cache->get(expression, &ExpressionProcessor::parse);
+  }
+
+  // Plain contiguous loops so the compiler emits packed add/sub instructions
+  // (SSE2 on every x64 target, AVX2 with /arch:AVX2)
+  static void add_column(int* out, const int* column, size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; ++i)
+      out[i] += column[i];
+  }
+
+  static void sub_column(int* out, const int* column, size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; ++i)
+      out[i] -= column[i];
+  }
 };
+
+// Replays a Zipf-distributed stream of expressions (a few hot strings, a long tail of distinct ones)
+// through a cached and an uncached processor and reports calls/sec and cache counters
+void benchmark_expression_cache(size_t distinctExpressions, size_t calls, double skew)
+{
+  mt19937 rng(42);
+  uniform_int_distribution<int> number(0, 99999);
+  vector<string> expressions;
+  for (size_t i = 0; i < distinctExpressions; ++i) {
+    string expression = to_string(i);
+    for (int term = 0; term < 24; ++term)
+      expression += (term % 2 ? "-" : "+") + (term % 3 ? to_string(number(rng)) : string(1, 'a' + term % 8));
+    expressions.push_back(expression);
+  }
+
+  vector<double> weights;
+  for (size_t rank = 1; rank <= distinctExpressions; ++rank)
+    weights.push_back(1.0 / pow(static_cast<double>(rank), skew));
+  discrete_distribution<size_t> zipf(weights.begin(), weights.end());
+  vector<size_t> workload(calls);
+  for (auto& index : workload)
+    index = zipf(rng);
+
+  auto run = [&](ExpressionProcessor& processor, const char* name) {
+    for (char v = 'a'; v <= 'h'; ++v)
+      processor.variables[v] = v;
+    long long checksum = 0;
+    auto start = chrono::steady_clock::now();
+    for (auto index : workload)
+      checksum += processor.calculate(expressions[index]);
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    auto stats = processor.cache_stats();
+    cout << name << ": " << static_cast<size_t>(calls / elapsed.count()) << " calls/sec"
+      << " (hits " << stats.hits << ", misses " << stats.misses << ", evictions " << stats.evictions
+      << ", checksum " << checksum << ")\n";
+  };
+
+  ExpressionProcessor uncached(0);
+  ExpressionProcessor cached(512);
+  run(uncached, "uncached");
+  run(cached, "cached  ");
+}
+
+// Checks calculate_batch row by row against calculate() with the same bindings
+bool batch_matches_calculate(size_t rows, size_t cacheCapacity = 512)
+{
+  mt19937 rng(26);
+  uniform_int_distribution<int> value(-1000, 1000);
+  map<char, vector<int>> columns;
+  for (char v : { 'a', 'b', 'c' })
+    for (size_t row = 0; row < rows; ++row)
+      columns[v].push_back(value(rng));
+
+  ExpressionProcessor batch(cacheCapacity);
+  batch.variables['z'] = 100;
+  for (const string expression : { "1+a-b+c-z", "a+b-12", "a+q", "1+2+xy", "7" }) {
+    const vector<int> results = batch.calculate_batch(expression, columns, rows);
+    ExpressionProcessor single;
+    single.variables['z'] = 100;
+    for (size_t row = 0; row < rows; ++row) {
+      for (const auto& column : columns)
+        single.variables[column.first] = column.second[row];
+      if (results[row] != single.calculate(expression))
+        return false;
+    }
+  }
+
+  try {
+    columns['c'].resize(rows / 2);
+    batch.calculate_batch("a+c", columns, rows);
+    return false;
+  }
+  catch (const invalid_argument&) {
+    return true;
+  }
+}
+
+// One thread keeps running calculate_batch while a copy of the processor (sharing its one-entry cache)
+// keeps evicting that entry with other expressions on a second thread
+bool batch_survives_concurrent_eviction(size_t rounds)
+{
+  const size_t rows = 64;
+  map<char, vector<int>> columns;
+  for (size_t row = 0; row < rows; ++row) {
+    columns['a'].push_back(static_cast<int>(row));
+    columns['b'].push_back(static_cast<int>(2 * row));
+  }
+
+  ExpressionProcessor batch(1);
+  ExpressionProcessor evictor = batch;
+  atomic<bool> running{ true };
+  thread evicting([&] {
+    for (int i = 0; running; ++i)
+      evictor.calculate(to_string(i % 100) + "+1");
+  });
+
+  bool ok = true;
+  for (size_t round = 0; round < rounds && ok; ++round) {
+    const vector<int> results = batch.calculate_batch("1+a-b", columns, rows);
+    for (size_t row = 0; row < rows; ++row)
+      ok = ok && results[row] == 1 - static_cast<int>(row);
+  }
+  running = false;
+  evicting.join();
+  return ok;
+}
+
+// The exercise's interface: default, copy-list-initialized, copied and moved processors
+bool processor_interface_works()
+{
+  ExpressionProcessor ep = {};
+  ep.variables['x'] = 3;
+  ExpressionProcessor copy = ep;
+  ExpressionProcessor moved = move(copy);
+  moved.variables['x'] = 4;
+  return ep.calculate("10-2-x") == 5 && moved.calculate("10-2-x") == 4 && ep.calculate("1+2+xy") == 0
+    && ep.cache_stats().hits == 1; // moved reused ep's parse
+}
+
+int main()
+{
+  cout << boolalpha << "copy/move/default interface: " << processor_interface_works() << "\n";
+  cout << "calculate_batch matches calculate: " << (batch_matches_calculate(20) && batch_matches_calculate(200000)
+    && batch_matches_calculate(20, 0)) << "\n";
+  cout << "calculate_batch survives concurrent eviction: " << batch_survives_concurrent_eviction(20000) << "\n";
+  benchmark_expression_cache(20000, 2000000, 1.2);
+}
@@ -5,8 +5,143 @@
 
 #include <iostream>
 #include <vector>
+#include <iterator>
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
 using namespace std;
 
+template <typename T>
+struct Node;
+
+enum class TraversalOrder { preorder, inorder, postorder };
+
+// Forward iterator over a subtree that walks it through the `parent` links:
+// no recursion and no auxiliary storage, only the current node and the subtree root
+template <typename T, TraversalOrder Order>
+class NodeIterator
+{
+  Node<T>* current;
+  Node<T>* root;
+
+public:
+  using iterator_category = forward_iterator_tag;
+  using value_type = Node<T>;
+  using difference_type = ptrdiff_t;
+  using pointer = Node<T>*;
+  using reference = Node<T>&;
+
+  NodeIterator(Node<T>* current, Node<T>* root) : current(current), root(root) {}
+
+  // first node of the subtree in this order, nullptr for an empty subtree
+  static Node<T>* first(Node<T>* root)
+  {
+    if (root == nullptr || Order == TraversalOrder::preorder)
+      return root;
+    if (Order == TraversalOrder::inorder)
+      return leftmost(root);
+    return first_leaf(root);
+  }
+
+  reference operator*() const { return *current; }
+  pointer operator->() const { return current; }
+
+  NodeIterator& operator++()
+  {
+    if (Order == TraversalOrder::preorder)
+      current = next_preorder(current);
+    else if (Order == TraversalOrder::inorder)
+      current = next_inorder(current);
+    else
+      current = next_postorder(current);
+    return *this;
+  }
+
+  NodeIterator operator++(int)
+  {
+    NodeIterator copy = *this;
+    ++*this;
+    return copy;
+  }
+
+  bool operator==(const NodeIterator& other) const { return current == other.current; }
+  bool operator!=(const NodeIterator& other) const { return current != other.current; }
+
+private:
+  static Node<T>* leftmost(Node<T>* node)
+  {
+    while (node->left != nullptr)
+      node = node->left;
+    return node;
+  }
+
+  static Node<T>* first_leaf(Node<T>* node)
+  {
+    while (node->left != nullptr || node->right != nullptr)
+      node = node->left != nullptr ? node->left : node->right;
+    return node;
+  }
+
+  Node<T>* next_preorder(Node<T>* node) const
+  {
+    if (node->left != nullptr)
+      return node->left;
+    if (node->right != nullptr)
+      return node->right;
+
+    // climb until we leave a left subtree whose parent still has a right child
+    while (node != root) {
+      Node<T>* parent = node->parent;
+      if (node == parent->left && parent->right != nullptr)
+        return parent->right;
+      node = parent;
+    }
+    return nullptr;
+  }
+
+  Node<T>* next_inorder(Node<T>* node) const
+  {
+    if (node->right != nullptr)
+      return leftmost(node->right);
+
+    // climb until we come up from a left subtree
+    while (node != root) {
+      Node<T>* parent = node->parent;
+      if (node == parent->left)
+        return parent;
+      node = parent;
+    }
+    return nullptr;
+  }
+
+  Node<T>* next_postorder(Node<T>* node) const
+  {
+    if (node == root)
+      return nullptr;
+
+    Node<T>* parent = node->parent;
+    if (node == parent->left && parent->right != nullptr)
+      return first_leaf(parent->right);
+    return parent;
+  }
+};
+
+template <typename T, TraversalOrder Order>
+struct NodeRange
+{
+  Node<T>* root;
+
+  NodeIterator<T, Order> begin() const { return { NodeIterator<T, Order>::first(root), root }; }
+  NodeIterator<T, Order> end() const { return { nullptr, root }; }
+};
+
 template <typename T>
 struct Node
 {
@@ -19,16 +154,409 @@ struct Node
     left->parent = right->parent = this;
   }
 
+  // lazy traversals of this subtree, e.g. `for (auto& node : root.preorder())`
+  NodeRange<T, TraversalOrder::preorder> preorder() { return { this }; }
+  NodeRange<T, TraversalOrder::inorder> inorder() { return { this }; }
+  NodeRange<T, TraversalOrder::postorder> postorder() { return { this }; }
+
   // traverse the node and its children preorder
   // and put all the results into `result`
   void preorder_traversal(vector<Node<T>*>& result)
   {
-    result.push_back(this); // Add the current node to the result
+    for (auto& node : preorder())
+      result.push_back(&node); // No recursion, so list-shaped trees cannot overflow the stack
+  }
+};
+
+// Allocates nodes in large contiguous blocks instead of one heap allocation per node.
+// Every node lives exactly as long as the arena.
+template <typename T>
+class NodeArena
+{
+  using Slot = typename aligned_storage<sizeof(Node<T>), alignof(Node<T>)>::type;
+
+  static constexpr size_t block_size = 1 << 16;
+  vector<unique_ptr<Slot[]>> blocks;
+  size_t used{ block_size };
+
+public:
+  NodeArena() = default;
+  NodeArena(const NodeArena&) = delete;
+  NodeArena& operator=(const NodeArena&) = delete;
+
+  ~NodeArena()
+  {
+    for (size_t b = 0; b < blocks.size(); ++b) {
+      size_t count = b + 1 == blocks.size() ? used : block_size;
+      for (size_t i = 0; i < count; ++i)
+        reinterpret_cast<Node<T>*>(&blocks[b][i])->~Node<T>();
+    }
+  }
 
-    if (left != nullptr)
-      left->preorder_traversal(result); // Recursively traverse the left subtree
+  Node<T>* make(T value)
+  {
+    return new (allocate()) Node<T>(value);
+  }
 
-    if (right != nullptr)
-      right->preorder_traversal(result); // Recursively traverse the right subtree
+  Node<T>* make(T value, Node<T>* left, Node<T>* right)
+  {
+    return new (allocate()) Node<T>(value, left, right);
   }
-};
\ No newline at end of file
+
+private:
+  void* allocate()
+  {
+    if (used == block_size) {
+      blocks.emplace_back(new Slot[block_size]);
+      used = 0;
+    }
+    return &blocks.back()[used++];
+  }
+};
+
+// Immutable copy of a finished tree laid out in preorder, with 32-bit child indices instead of pointers.
+// A full preorder traversal is a linear scan over `values`; the left child of node i, if any, is i + 1.
+template <typename T>
+struct FrozenTree
+{
+  static constexpr uint32_t none = UINT32_MAX;
+
+  struct Children
+  {
+    uint32_t left, right;
+  };
+
+  vector<T> values;
+  vector<Children> children;
+
+  explicit FrozenTree(Node<T>* root)
+  {
+    if (root == nullptr)
+      return;
+
+    // Explicit stack of nodes still to place, each with its parent's index (none for the root)
+    // and whether it hangs on the left; right subtrees wait while the left ones are laid out first
+    struct Pending
+    {
+      Node<T>* node;
+      uint32_t parent;
+      bool isLeft;
+    };
+    vector<Pending> pending{ { root, none, false } };
+
+    while (!pending.empty()) {
+      Pending next = pending.back();
+      pending.pop_back();
+
+      const uint32_t index = static_cast<uint32_t>(values.size());
+      if (next.parent != none)
+        (next.isLeft ? children[next.parent].left : children[next.parent].right) = index;
+      values.push_back(next.node->value);
+      children.push_back({ none, none });
+
+      if (next.node->right != nullptr)
+        pending.push_back({ next.node->right, index, false });
+      if (next.node->left != nullptr)
+        pending.push_back({ next.node->left, index, true });
+    }
+  }
+
+  size_t size() const { return values.size(); }
+
+  template <typename F>
+  void preorder_for_each(F f) const
+  {
+    for (const auto& value : values)
+      f(value);
+  }
+};
+
+// Runs a visitor over every node of a tree on several threads. Each task walks one subtree with an explicit
+// stack; after every `grain` nodes, if its own queue is empty, it hands its oldest pending subtree (the
+// shallowest, so usually the largest) to that queue where idle workers can steal it. This keeps
+// unbalanced and list-shaped trees busy on all threads without knowing subtree sizes in advance.
+//
+// Every task writes into its own output segment. A donated subtree comes right after the donating task's
+// remaining nodes in serial preorder, so its segment is linked in right after the donor's; walking the
+// segment list from the head therefore yields the exact serial preorder sequence.
+template <typename T>
+class SubtreeScheduler
+{
+public:
+  struct Segment
+  {
+    vector<Node<T>*> nodes;
+    Segment* next{ nullptr }; // written only by the task that owns this segment
+  };
+
+  SubtreeScheduler(size_t threadCount, size_t grain)
+    : threadCount(max<size_t>(1, threadCount)), grain(max<size_t>(1, grain))
+  {
+    for (size_t i = 0; i < this->threadCount; ++i)
+      queues.emplace_back(new WorkerQueue);
+  }
+
+  size_t thread_count() const { return threadCount; }
+
+  // visit(worker, segment, node) is called once per node, concurrently from different workers
+  template <typename Visit>
+  Segment* run(Node<T>* root, Visit visit)
+  {
+    if (root == nullptr)
+      return nullptr;
+
+    Segment* head = new_segment();
+    pendingTasks = 1;
+    queues[0]->tasks.push_back({ root, head });
+
+    vector<thread> workers;
+    for (size_t w = 1; w < threadCount; ++w)
+      workers.emplace_back([this, w, &visit] { work(w, visit); });
+    work(0, visit);
+    for (auto& worker : workers)
+      worker.join();
+
+    return head;
+  }
+
+private:
+  struct Task
+  {
+    Node<T>* root;
+    Segment* segment;
+  };
+
+  struct WorkerQueue
+  {
+    mutex mtx;
+    deque<Task> tasks;
+  };
+
+  const size_t threadCount;
+  const size_t grain;
+  vector<unique_ptr<WorkerQueue>> queues;
+  atomic<size_t> pendingTasks{ 0 };
+
+  mutex segmentsMutex;
+  deque<Segment> segments; // deque keeps segment addresses stable while it grows
+
+  Segment* new_segment()
+  {
+    lock_guard<mutex> lock(segmentsMutex);
+    segments.emplace_back();
+    return &segments.back();
+  }
+
+  bool pop_local(size_t worker, Task& task)
+  {
+    WorkerQueue& queue = *queues[worker];
+    lock_guard<mutex> lock(queue.mtx);
+    if (queue.tasks.empty())
+      return false;
+    task = queue.tasks.back();
+    queue.tasks.pop_back();
+    return true;
+  }
+
+  bool steal(size_t thief, Task& task)
+  {
+    for (size_t i = 1; i < threadCount; ++i) {
+      WorkerQueue& victim = *queues[(thief + i) % threadCount];
+      lock_guard<mutex> lock(victim.mtx);
+      if (!victim.tasks.empty()) {
+        task = victim.tasks.front(); // steal the oldest, largest task
+        victim.tasks.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template <typename Visit>
+  void work(size_t worker, Visit& visit)
+  {
+    vector<Node<T>*> stack;
+    Task task;
+    while (pendingTasks.load() != 0) {
+      if (pop_local(worker, task) || steal(worker, task)) {
+        execute(worker, task, stack, visit);
+        --pendingTasks;
+      }
+      else {
+        this_thread::yield();
+      }
+    }
+  }
+
+  template <typename Visit>
+  void execute(size_t worker, const Task& task, vector<Node<T>*>& stack, Visit& visit)
+  {
+    WorkerQueue& queue = *queues[worker];
+    stack.assign(1, task.root);
+    size_t bottom = 0; // stack[bottom] is the next subtree to donate
+    size_t sinceDonation = 0;
+
+    while (stack.size() > bottom) {
+      Node<T>* node = stack.back();
+      stack.pop_back();
+      visit(worker, *task.segment, *node);
+      if (node->right != nullptr)
+        stack.push_back(node->right);
+      if (node->left != nullptr)
+        stack.push_back(node->left);
+
+      if (++sinceDonation >= grain && stack.size() - bottom > 1 && threadCount > 1) {
+        sinceDonation = 0;
+        lock_guard<mutex> lock(queue.mtx);
+        if (!queue.tasks.empty())
+          continue;
+
+        Segment* donated = new_segment();
+        donated->next = task.segment->next;
+        task.segment->next = donated;
+        ++pendingTasks;
+        queue.tasks.push_back({ stack[bottom++], donated });
+      }
+    }
+  }
+};
+
+// Calls f(node) for every node of the tree, in no particular order and concurrently from several threads
+template <typename T, typename F>
+void parallel_for_each(Node<T>* root, F f, size_t grain = 4096, size_t threads = thread::hardware_concurrency())
+{
+  SubtreeScheduler<T> scheduler(threads, grain);
+  scheduler.run(root, [&](size_t, typename SubtreeScheduler<T>::Segment&, Node<T>& node) { f(node); });
+}
+
+// Folds map(node) over every node with `combine`, which has to be associative and commutative
+// because nodes are combined per worker in whatever order the workers reached them
+template <typename T, typename R, typename Map, typename Combine>
+R parallel_reduce(Node<T>* root, R identity, Map map, Combine combine, size_t grain = 4096,
+  size_t threads = thread::hardware_concurrency())
+{
+  SubtreeScheduler<T> scheduler(threads, grain);
+  vector<R> partial(scheduler.thread_count(), identity);
+  scheduler.run(root, [&](size_t worker, typename SubtreeScheduler<T>::Segment&, Node<T>& node) {
+    partial[worker] = combine(partial[worker], map(node));
+  });
+
+  R result = identity;
+  for (const auto& value : partial)
+    result = combine(result, value);
+  return result;
+}
+
+// Parallel equivalent of preorder_traversal: the per-subtree buffers are stitched back in serial preorder
+template <typename T>
+void parallel_preorder_traversal(Node<T>* root, vector<Node<T>*>& result, size_t grain = 4096,
+  size_t threads = thread::hardware_concurrency())
+{
+  SubtreeScheduler<T> scheduler(threads, grain);
+  auto head = scheduler.run(root, [](size_t, typename SubtreeScheduler<T>::Segment& segment, Node<T>& node) {
+    segment.nodes.push_back(&node);
+  });
+
+  for (auto segment = head; segment != nullptr; segment = segment->next)
+    result.insert(result.end(), segment->nodes.begin(), segment->nodes.end());
+}
+
+// Builds the same randomly shaped tree of `count` nodes with `make` (so parents and children end up
+// far apart in allocation order) and links the nodes through `parent` pointers
+template <typename T, typename MakeNode>
+Node<T>* build_random_tree(size_t count, MakeNode make)
+{
+  mt19937 rng(7);
+  Node<T>* root = make(T(0));
+  vector<pair<Node<T>*, bool>> freeSlots{ { root, true }, { root, false } };
+
+  for (size_t i = 1; i < count; ++i) {
+    size_t pick = uniform_int_distribution<size_t>(0, freeSlots.size() - 1)(rng);
+    auto slot = freeSlots[pick];
+    freeSlots[pick] = freeSlots.back();
+    freeSlots.pop_back();
+
+    Node<T>* node = make(static_cast<T>(i));
+    node->parent = slot.first;
+    (slot.second ? slot.first->left : slot.first->right) = node;
+    freeSlots.emplace_back(node, true);
+    freeSlots.emplace_back(node, false);
+  }
+  return root;
+}
+
+// Times one full preorder traversal of a `count`-node tree in pointer, arena and frozen layouts
+void benchmark_layouts(size_t count)
+{
+  auto time = [](const char* name, auto traverse) {
+    auto start = chrono::steady_clock::now();
+    long long sum = traverse();
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    cout << name << ": " << elapsed.count() << " ms (checksum " << sum << ")\n";
+  };
+
+  Node<int>* pointerRoot = build_random_tree<int>(count, [](int value) { return new Node<int>(value); });
+  time("pointer", [&] {
+    long long sum = 0;
+    for (auto& node : pointerRoot->preorder())
+      sum += node.value;
+    return sum;
+  });
+
+  {
+    NodeArena<int> arena;
+    Node<int>* arenaRoot = build_random_tree<int>(count, [&](int value) { return arena.make(value); });
+    time("arena  ", [&] {
+      long long sum = 0;
+      for (auto& node : arenaRoot->preorder())
+        sum += node.value;
+      return sum;
+    });
+  }
+
+  FrozenTree<int> frozen(pointerRoot);
+  time("frozen ", [&] {
+    long long sum = 0;
+    frozen.preorder_for_each([&](int value) { sum += value; });
+    return sum;
+  });
+
+  // Postorder visits children before their parent, so each node can be freed once we move past it
+  auto nodes = pointerRoot->postorder();
+  for (auto it = nodes.begin(); it != nodes.end();) {
+    Node<int>* node = &*it;
+    ++it;
+    delete node;
+  }
+}
+
+// Compares the parallel traversals with preorder_traversal and a sequential sum for several grains and thread counts
+bool parallel_matches_sequential(size_t count)
+{
+  NodeArena<int> arena;
+  Node<int>* root = build_random_tree<int>(count, [&](int value) { return arena.make(value); });
+  vector<Node<int>*> expected;
+  root->preorder_traversal(expected);
+  long long expectedSum = 0;
+  for (auto node : expected)
+    expectedSum += node->value;
+
+  for (size_t grain : { 1, 64, 4096 })
+    for (size_t threads : { 1, 3, 8 }) {
+      vector<Node<int>*> order;
+      parallel_preorder_traversal(root, order, grain, threads);
+      atomic<long long> visitedSum{ 0 };
+      parallel_for_each(root, [&](Node<int>& node) { visitedSum += node.value; }, grain, threads);
+      const long long reduced = parallel_reduce(root, 0LL, [](Node<int>& node) { return static_cast<long long>(node.value); },
+        [](long long a, long long b) { return a + b; }, grain, threads);
+      if (order != expected || visitedSum != expectedSum || reduced != expectedSum)
+        return false;
+    }
+  return true;
+}
+
+int main()
+{
+  cout << boolalpha << "parallel traversals match sequential: " << (parallel_matches_sequential(1) && parallel_matches_sequential(100000)) << "\n";
+  benchmark_layouts(10000000);
+}
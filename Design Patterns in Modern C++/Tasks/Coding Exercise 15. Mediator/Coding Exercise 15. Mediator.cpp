@@ -9,6 +9,15 @@
 //Participant 2 broadcasts the value 2. We now have Participant 1 value = 2, Participant 2 value = 3
 
 #include <vector>
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <iostream>
 using namespace std;
 
 struct IParticipant
@@ -21,7 +30,10 @@ struct IParticipant
 struct Mediator
 {
   vector<IParticipant*> participants;
-  void broadcast(const IParticipant* origin, int value)
+
+  virtual ~Mediator() = default;
+
+  virtual void broadcast(const IParticipant* origin, int value)
   {
     for (auto p : participants)
       if ((const IParticipant*)p != origin)
@@ -50,7 +62,584 @@ struct Participant : IParticipant
   }
 };
 
+// Mediator that keeps one running total of everything broadcast instead of pushing each value to everyone.
+// OffsetParticipants derive their value from that total on read, so say() is O(1) for them; participants
+// registered in `participants` (e.g. plain Participant) still get receive() callbacks as before.
+struct OffsetMediator : Mediator
+{
+  long long total{ 0 };
+
+  void broadcast(const IParticipant* origin, int value) override
+  {
+    total += value;
+    Mediator::broadcast(origin, value);
+  }
+};
+
+struct OffsetParticipant : IParticipant
+{
+  OffsetMediator& mediator;
+  long long offset; // mediator total when we joined plus everything we said ourselves
+
+  OffsetParticipant(OffsetMediator& mediator) : mediator(mediator), offset(mediator.total) {}
+
+  int value() const
+  {
+    return static_cast<int>(mediator.total - offset);
+  }
+
+  void receive(int) override {} // nothing to do, value() is derived from the mediator total
+
+  void say(int val) override
+  {
+    offset += val;
+    mediator.broadcast((const IParticipant*)(this), val);
+  }
+};
+
+// Bounded lock-free ring buffer for many producers and a single consumer. Each cell carries a sequence
+// number telling whether it is free for the producer that claimed its position or ready for the consumer,
+// so messages pushed by one producer are popped in the order it pushed them.
+template <typename T>
+class MpscRing
+{
+  struct Cell
+  {
+    atomic<size_t> sequence;
+    T data;
+  };
+
+  const size_t mask;
+  unique_ptr<Cell[]> cells;
+  // padding keeps the producers' tail and the consumer's head on separate cache lines
+  // (alignas would need over-aligned new, which C++14 does not have)
+  char padding0[64];
+  atomic<size_t> tail{ 0 }; // next position claimed by a producer
+  char padding1[64];
+  size_t head{ 0 };         // next position read by the consumer
+  char padding2[64];
+
+public:
+  // capacity is rounded up to a power of two
+  explicit MpscRing(size_t capacity) : mask(round_up(capacity) - 1), cells(new Cell[mask + 1])
+  {
+    for (size_t i = 0; i <= mask; ++i)
+      cells[i].sequence.store(i, memory_order_relaxed);
+  }
+
+  bool try_push(const T& value)
+  {
+    size_t pos = tail.load(memory_order_relaxed);
+    for (;;) {
+      Cell& cell = cells[pos & mask];
+      size_t sequence = cell.sequence.load(memory_order_acquire);
+      if (sequence == pos) {
+        if (tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+          cell.data = value;
+          cell.sequence.store(pos + 1, memory_order_release);
+          return true;
+        }
+      }
+      else if (sequence < pos) {
+        return false; // full: the consumer has not freed this cell yet
+      }
+      else {
+        pos = tail.load(memory_order_relaxed);
+      }
+    }
+  }
+
+  bool try_pop(T& value)
+  {
+    Cell& cell = cells[head & mask];
+    if (cell.sequence.load(memory_order_acquire) != head + 1)
+      return false; // empty, or the producer of this position has not finished writing
+    value = cell.data;
+    cell.sequence.store(head + mask + 1, memory_order_release);
+    ++head;
+    return true;
+  }
+
+private:
+  static size_t round_up(size_t capacity)
+  {
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+    return size;
+  }
+};
+
+struct AsyncParticipant;
+
+// Mediator whose say() only enqueues: every participant has a bounded MPSC inbox and is owned by exactly
+// one worker thread, which drains the inbox in batches and applies the values. say() may be called from
+// any thread; each sender's messages reach every inbox in the order they were said. Participants join
+// before start(), and their values are only meaningful after flush().
+class AsyncMediator
+{
+public:
+  struct Message
+  {
+    int value;
+    chrono::steady_clock::time_point sentAt;
+  };
+
+  const size_t inboxCapacity;
+
+  AsyncMediator(size_t workerCount, size_t inboxCapacity = 1024)
+    : inboxCapacity(inboxCapacity), workerCount(max<size_t>(1, workerCount)), latencySamples(this->workerCount) {}
+
+  ~AsyncMediator()
+  {
+    stop();
+  }
+
+  void join(AsyncParticipant* participant)
+  {
+    participants.push_back(participant);
+  }
+
+  void start();
+
+  void stop()
+  {
+    running = false;
+    for (auto& worker : workers)
+      worker.join();
+    workers.clear();
+  }
+
+  void broadcast(const IParticipant* origin, int value);
+
+  // blocks until every message enqueued so far has been applied
+  void flush() const
+  {
+    while (applied.load(memory_order_acquire) != enqueued.load(memory_order_acquire))
+      this_thread::yield();
+  }
+
+  // delivery latency percentile (0..1) over sampled messages since start(), in microseconds
+  double latency_percentile(double percentile) const
+  {
+    vector<double> samples;
+    for (const auto& worker : latencySamples)
+      samples.insert(samples.end(), worker.begin(), worker.end());
+    if (samples.empty())
+      return 0;
+    size_t rank = min(samples.size() - 1, static_cast<size_t>(percentile * samples.size()));
+    nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    return samples[rank];
+  }
+
+private:
+  static constexpr size_t batch_size = 256;
+  static constexpr size_t sample_every = 8;
+
+  const size_t workerCount;
+  vector<AsyncParticipant*> participants;
+  vector<thread> workers;
+  vector<vector<double>> latencySamples; // per worker, so recording needs no synchronization
+  atomic<bool> running{ false };
+  atomic<size_t> enqueued{ 0 };
+  atomic<size_t> applied{ 0 };
+
+  void work(size_t worker);
+};
+
+struct AsyncParticipant : IParticipant
+{
+  int value{ 0 }; // written only by the worker that owns this participant
+  AsyncMediator& mediator;
+  MpscRing<AsyncMediator::Message> inbox;
+
+  AsyncParticipant(AsyncMediator& mediator) : mediator(mediator), inbox(mediator.inboxCapacity)
+  {
+    mediator.join(this);
+  }
+
+  void receive(int val) override
+  {
+    this->value += val;
+  }
+
+  void say(int val) override
+  {
+    mediator.broadcast((const IParticipant*)(this), val);
+  }
+};
+
+void AsyncMediator::start()
+{
+  running = true;
+  for (size_t w = 0; w < workerCount; ++w)
+    workers.emplace_back(&AsyncMediator::work, this, w);
+}
+
+void AsyncMediator::broadcast(const IParticipant* origin, int value)
+{
+  const Message message{ value, chrono::steady_clock::now() };
+  // counted before any push so flush() never sees applied catch up with a stale total; the origin need not
+  // be a participant (nullptr or an outsider reaches everyone)
+  size_t recipients = 0;
+  for (auto p : participants)
+    recipients += (const IParticipant*)p != origin;
+  enqueued.fetch_add(recipients, memory_order_relaxed);
+  for (auto p : participants) {
+    if ((const IParticipant*)p == origin)
+      continue;
+    while (!p->inbox.try_push(message))
+      this_thread::yield(); // inbox full, wait for its worker to catch up
+  }
+}
+
+void AsyncMediator::work(size_t worker)
+{
+  auto& samples = latencySamples[worker];
+  size_t seen = 0;
+  Message message;
+
+  while (running.load(memory_order_relaxed)) {
+    size_t batchApplied = 0;
+
+    for (size_t i = worker; i < participants.size(); i += workerCount) {
+      AsyncParticipant* participant = participants[i];
+      for (size_t n = 0; n < batch_size && participant->inbox.try_pop(message); ++n) {
+        participant->receive(message.value);
+        // timed after the pop, so a message sent while this sweep was running is not measured short
+        if (++seen % sample_every == 0)
+          samples.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - message.sentAt).count());
+        ++batchApplied;
+      }
+    }
+
+    if (batchApplied != 0)
+      applied.fetch_add(batchApplied, memory_order_release);
+    else
+      this_thread::yield();
+  }
+}
+
+struct TopicParticipant;
+
+// Mediator with named topics: a value said on a topic reaches only that topic's subscribers. Each topic
+// keeps a compact array of subscribers, and every subscription remembers its slot in that array. A
+// participant finds its subscription to a topic through a hash index, so subscribe and unsubscribe are
+// O(1) expected (unsubscribe swaps the last subscriber into the freed slot).
+struct TopicMediator
+{
+  unordered_map<string, size_t> topicIds;
+  vector<vector<TopicParticipant*>> subscribers; // indexed by topic id
+
+  // id of the topic with this name, created on first use; say and subscribe by id to skip the lookup
+  size_t topic(const string& name)
+  {
+    auto it = topicIds.find(name);
+    if (it != topicIds.end())
+      return it->second;
+    subscribers.emplace_back();
+    return topicIds[name] = subscribers.size() - 1;
+  }
+
+  void broadcast(const IParticipant* origin, size_t topic, int value);
+};
+
+struct TopicParticipant : IParticipant
+{
+  struct Subscription
+  {
+    size_t topic;
+    size_t slot; // position in mediator.subscribers[topic]
+  };
+
+  int value{ 0 };
+  TopicMediator& mediator;
+  vector<Subscription> subscriptions;
+  unordered_map<size_t, size_t> subscriptionIndex; // topic -> position in subscriptions
+
+  TopicParticipant(TopicMediator& mediator) : mediator(mediator) {}
+
+  ~TopicParticipant()
+  {
+    while (!subscriptions.empty())
+      unsubscribe(subscriptions.back().topic);
+  }
+
+  void subscribe(size_t topic)
+  {
+    if (subscriptionIndex.count(topic))
+      return;
+    auto& topicSubscribers = mediator.subscribers[topic];
+    subscriptionIndex[topic] = subscriptions.size();
+    subscriptions.push_back({ topic, topicSubscribers.size() });
+    topicSubscribers.push_back(this);
+  }
+
+  void subscribe(const string& topic)
+  {
+    subscribe(mediator.topic(topic));
+  }
+
+  void unsubscribe(size_t topic)
+  {
+    auto found = subscriptionIndex.find(topic);
+    if (found == subscriptionIndex.end())
+      return;
+    const size_t index = found->second;
+    const size_t slot = subscriptions[index].slot;
+
+    auto& topicSubscribers = mediator.subscribers[topic];
+    TopicParticipant* moved = topicSubscribers.back();
+    topicSubscribers[slot] = moved;
+    moved->subscriptions[moved->subscriptionIndex[topic]].slot = slot;
+    topicSubscribers.pop_back();
+
+    subscriptions[index] = subscriptions.back();
+    subscriptionIndex[subscriptions[index].topic] = index;
+    subscriptionIndex.erase(topic);
+    subscriptions.pop_back();
+  }
+
+  void unsubscribe(const string& topic)
+  {
+    unsubscribe(mediator.topic(topic));
+  }
+
+  void receive(int val) override
+  {
+    this->value += val;
+  }
+
+  void say(size_t topic, int val)
+  {
+    mediator.broadcast((const IParticipant*)(this), topic, val);
+  }
+
+  void say(const string& topic, int val)
+  {
+    say(mediator.topic(topic), val);
+  }
+
+  // without a topic, the value is said on every topic we are subscribed to
+  void say(int val) override
+  {
+    for (const auto& subscription : subscriptions)
+      say(subscription.topic, val);
+  }
+};
+
+void TopicMediator::broadcast(const IParticipant* origin, size_t topic, int value)
+{
+  for (auto p : subscribers[topic])
+    if ((const IParticipant*)p != origin)
+      p->receive(value);
+}
+
+// Compares `says` random says through the flat Mediator against a TopicMediator where every participant
+// subscribes to `subscriptionsPerParticipant` of `topicCount` topics; reports ns per say
+void benchmark_topic_mediator(size_t participantCount, size_t topicCount, size_t subscriptionsPerParticipant, size_t says)
+{
+  mt19937 rng(3);
+  vector<size_t> speakers(says);
+  for (auto& speaker : speakers)
+    speaker = rng() % participantCount;
+
+  Mediator flat;
+  vector<unique_ptr<Participant>> flatParticipants;
+  for (size_t i = 0; i < participantCount; ++i)
+    flatParticipants.emplace_back(new Participant(flat));
+
+  TopicMediator topics;
+  for (size_t t = 0; t < topicCount; ++t)
+    topics.topic("topic" + to_string(t));
+  vector<unique_ptr<TopicParticipant>> topicParticipants;
+  for (size_t i = 0; i < participantCount; ++i) {
+    topicParticipants.emplace_back(new TopicParticipant(topics));
+    for (size_t k = 0; k < subscriptionsPerParticipant; ++k)
+      topicParticipants.back()->subscribe(rng() % topicCount);
+  }
+
+  auto start = chrono::steady_clock::now();
+  for (auto speaker : speakers)
+    flatParticipants[speaker]->say(1);
+  double flatNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / says;
+
+  start = chrono::steady_clock::now();
+  for (auto speaker : speakers) {
+    auto& subscriptions = topicParticipants[speaker]->subscriptions;
+    if (!subscriptions.empty())
+      topicParticipants[speaker]->say(subscriptions[speaker % subscriptions.size()].topic, 1);
+  }
+  double topicNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / says;
+
+  cout << participantCount << " participants, " << subscriptionsPerParticipant << "/" << topicCount
+    << " topics each: flat " << flatNs << " ns/say, topics " << topicNs << " ns/say\n";
+}
+
+// Every sender thread repeatedly makes its share of the participants say 1; reports delivered
+// messages/sec and p99 delivery latency, and checks every participant received all the others' values
+void benchmark_async_mediator(size_t threadCount, size_t participantCount, size_t messagesTarget)
+{
+  AsyncMediator mediator(threadCount);
+  vector<unique_ptr<AsyncParticipant>> participants;
+  for (size_t i = 0; i < participantCount; ++i)
+    participants.emplace_back(new AsyncParticipant(mediator));
+  const size_t says = max<size_t>(1, messagesTarget / (participantCount * (participantCount - 1)));
+
+  mediator.start();
+  auto start = chrono::steady_clock::now();
+  vector<thread> senders;
+  for (size_t t = 0; t < threadCount; ++t) {
+    senders.emplace_back([&, t] {
+      for (size_t round = 0; round < says; ++round)
+        for (size_t i = t; i < participantCount; i += threadCount)
+          participants[i]->say(1);
+    });
+  }
+  for (auto& sender : senders)
+    sender.join();
+  mediator.flush();
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  mediator.stop();
+
+  bool consistent = all_of(participants.begin(), participants.end(), [&](const unique_ptr<AsyncParticipant>& p) {
+    return p->value == static_cast<int>(says * (participantCount - 1));
+  });
+  const double messages = static_cast<double>(says * participantCount * (participantCount - 1));
+  cout << threadCount << " threads, " << participantCount << " participants: "
+    << static_cast<size_t>(messages / elapsed.count()) << " messages/sec, p99 "
+    << mediator.latency_percentile(0.99) << " us" << (consistent ? "" : " (INCONSISTENT)") << "\n";
+}
+
+// Random subscribes, unsubscribes and says against a plain set-based model of who hears which topic;
+// checks swap-remove keeps every other subscriber's routing intact
+bool topic_routing_survives_unsubscribe(size_t steps)
+{
+  mt19937 rng(33);
+  const size_t participantCount = 20, topicCount = 6;
+  TopicMediator mediator;
+  for (size_t t = 0; t < topicCount; ++t)
+    mediator.topic("topic" + to_string(t));
+  vector<unique_ptr<TopicParticipant>> participants;
+  for (size_t i = 0; i < participantCount; ++i)
+    participants.emplace_back(new TopicParticipant(mediator));
+  vector<vector<bool>> subscribed(participantCount, vector<bool>(topicCount, false));
+  vector<int> expected(participantCount, 0);
+
+  for (size_t step = 0; step < steps; ++step) {
+    const size_t p = rng() % participantCount, topic = rng() % topicCount;
+    switch (rng() % 3) {
+    case 0:
+      participants[p]->subscribe(topic);
+      subscribed[p][topic] = true;
+      break;
+    case 1:
+      participants[p]->unsubscribe(topic);
+      subscribed[p][topic] = false;
+      break;
+    default:
+      participants[p]->say(topic, static_cast<int>(step));
+      for (size_t q = 0; q < participantCount; ++q)
+        if (q != p && subscribed[q][topic])
+          expected[q] += static_cast<int>(step);
+    }
+  }
+
+  for (size_t p = 0; p < participantCount; ++p)
+    if (participants[p]->value != expected[p])
+      return false;
+  return true;
+}
+
+// Broadcasts from senders that are not participants of the mediator; flush() must still wait for exactly
+// the messages that were pushed
+bool async_broadcast_from_outsiders()
+{
+  AsyncMediator mediator(2);
+  AsyncMediator other(1);
+  vector<unique_ptr<AsyncParticipant>> participants;
+  for (int i = 0; i < 5; ++i)
+    participants.emplace_back(new AsyncParticipant(mediator));
+  AsyncParticipant outsider(other);
+
+  mediator.start();
+  mediator.broadcast(nullptr, 3);
+  mediator.broadcast(&outsider, 4);
+  participants[0]->say(10);
+  mediator.flush();
+  mediator.stop();
+  return participants[0]->value == 7 && all_of(participants.begin() + 1, participants.end(),
+    [](const unique_ptr<AsyncParticipant>& p) { return p->value == 17; });
+}
+
+// Replays the same random sequence of joins and says through the broadcasting Mediator and the
+// OffsetMediator (mixing in callback participants) and compares every participant's value
+bool offset_mediator_matches_broadcast(size_t steps)
+{
+  mt19937 rng(1);
+  Mediator mediator;
+  OffsetMediator offsetMediator;
+  vector<unique_ptr<Participant>> participants, callbackParticipants;
+  vector<unique_ptr<OffsetParticipant>> offsetParticipants;
+  vector<bool> usesCallback;
+
+  for (size_t step = 0; step < steps; ++step) {
+    if (participants.empty() || rng() % 4 == 0) {
+      participants.emplace_back(new Participant(mediator));
+      bool callback = rng() % 3 == 0;
+      usesCallback.push_back(callback);
+      callbackParticipants.emplace_back(callback ? new Participant(offsetMediator) : nullptr);
+      offsetParticipants.emplace_back(callback ? nullptr : new OffsetParticipant(offsetMediator));
+      continue;
+    }
+
+    size_t speaker = rng() % participants.size();
+    int val = static_cast<int>(rng() % 201) - 100;
+    participants[speaker]->say(val);
+    if (usesCallback[speaker])
+      callbackParticipants[speaker]->say(val);
+    else
+      offsetParticipants[speaker]->say(val);
+
+    for (size_t i = 0; i < participants.size(); ++i) {
+      int value = usesCallback[i] ? callbackParticipants[i]->value : offsetParticipants[i]->value();
+      if (value != participants[i]->value)
+        return false;
+    }
+  }
+  return true;
+}
+
+// Times one round in which every one of `count` participants says something
+template <typename MediatorType, typename ParticipantType>
+double time_round(size_t count)
+{
+  MediatorType mediator;
+  vector<unique_ptr<ParticipantType>> participants;
+  for (size_t i = 0; i < count; ++i)
+    participants.emplace_back(new ParticipantType(mediator));
+
+  auto start = chrono::steady_clock::now();
+  for (auto& participant : participants)
+    participant->say(1);
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
 int main()
 {
+  cout << "offset mediator matches broadcast: " << boolalpha << offset_mediator_matches_broadcast(2000) << "\n";
+  cout << "async broadcast from outsiders flushes exactly: " << async_broadcast_from_outsiders() << "\n";
+  cout << "topic routing survives unsubscribe: " << topic_routing_survives_unsubscribe(20000) << "\n";
+
+  const size_t count = 20000;
+  cout << "round of " << count << " says, broadcast: " << time_round<Mediator, Participant>(count) << " ms\n";
+  cout << "round of " << count << " says, offset:    " << time_round<OffsetMediator, OffsetParticipant>(count) << " ms\n";
+
+  const size_t maxThreads = max(2u, thread::hardware_concurrency());
+  for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+    for (size_t participantCount : { 8, 64, 512 })
+      benchmark_async_mediator(threads, participantCount, 2000000);
 
+  for (size_t subscriptionsPerParticipant : { 1, 3, 10, 50 })
+    benchmark_topic_mediator(10000, 100, subscriptionsPerParticipant, 20000);
 }
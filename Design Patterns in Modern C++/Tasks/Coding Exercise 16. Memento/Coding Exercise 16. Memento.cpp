@@ -5,8 +5,31 @@
 //Pay close attention to the situation where a token is fed in as a smart pointerand its value is subsequently changed on that pointer - you still need to return the correct system snapshot!
 
 #include <iostream>
+#include <fstream>
+#include <string>
 #include <vector>
+#include <array>
 #include <memory>
+#include <stdexcept>
+#include <atomic>
+#include <thread>
+#include <deque>
+#include <chrono>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
 struct Token
@@ -28,6 +51,8 @@ struct Memento
       this->tokens.push_back(*token); // Copy Token objects
     }
   }
+
+  Memento(vector<Token> tokens) : tokens(move(tokens)) {}
 };
 
 struct TokenMachine
@@ -55,7 +80,853 @@ struct TokenMachine
   }
 };
 
+// Immutable vector with structural sharing: a 32-way trie of full chunks plus a tail chunk that is still
+// being filled. push_back copies at most the tail and one path of the trie, every other chunk is shared
+// with the previous versions, so copying the vector (taking a snapshot) is O(1).
+template <typename T>
+class PersistentVector
+{
+  static constexpr size_t bits = 5;
+  static constexpr size_t width = 1 << bits;
+  static constexpr size_t mask = width - 1;
+
+  struct Node
+  {
+    virtual ~Node() = default;
+  };
+
+  struct Branch : Node
+  {
+    array<shared_ptr<const Node>, width> children;
+  };
+
+  struct Leaf : Node
+  {
+    array<T, width> values{};
+  };
+
+  size_t count{ 0 };
+  size_t shift{ bits }; // bit offset of the root level
+  shared_ptr<const Branch> root{ make_shared<Branch>() };
+  shared_ptr<const Leaf> tail{ make_shared<Leaf>() };
+
+public:
+  size_t size() const { return count; }
+
+  const T& operator[](size_t index) const
+  {
+    if (index >= tail_offset())
+      return tail->values[index & mask];
+
+    const Node* node = root.get();
+    for (size_t level = shift; level > 0; level -= bits)
+      node = static_cast<const Branch*>(node)->children[(index >> level) & mask].get();
+    return static_cast<const Leaf*>(node)->values[index & mask];
+  }
+
+  void push_back(const T& value)
+  {
+    if (count - tail_offset() < width) {
+      auto newTail = make_shared<Leaf>(*tail);
+      newTail->values[count & mask] = value;
+      tail = move(newTail);
+      ++count;
+      return;
+    }
+
+    // The tail is full: it becomes a chunk of the trie, growing the trie by one level if the root is full
+    if ((count >> bits) > (size_t{ 1 } << shift)) {
+      auto newRoot = make_shared<Branch>();
+      newRoot->children[0] = root;
+      newRoot->children[1] = new_path(shift, tail);
+      root = move(newRoot);
+      shift += bits;
+    }
+    else {
+      root = push_tail(shift, *root, tail);
+    }
+
+    auto newTail = make_shared<Leaf>();
+    newTail->values[0] = value;
+    tail = move(newTail);
+    ++count;
+  }
+
+private:
+  size_t tail_offset() const
+  {
+    return count < width ? 0 : ((count - 1) >> bits) << bits;
+  }
+
+  static shared_ptr<const Node> new_path(size_t level, shared_ptr<const Node> node)
+  {
+    if (level == 0)
+      return node;
+    auto branch = make_shared<Branch>();
+    branch->children[0] = new_path(level - bits, move(node));
+    return branch;
+  }
+
+  shared_ptr<const Branch> push_tail(size_t level, const Branch& parent, shared_ptr<const Node> tailNode) const
+  {
+    const size_t child = ((count - 1) >> level) & mask;
+    auto copy = make_shared<Branch>(parent); // copies only this node's child pointers
+    if (level == bits)
+      copy->children[child] = move(tailNode);
+    else if (parent.children[child])
+      copy->children[child] = push_tail(level - bits, static_cast<const Branch&>(*parent.children[child]), move(tailNode));
+    else
+      copy->children[child] = new_path(level - bits, move(tailNode));
+    return copy;
+  }
+};
+
+// Memento over a PersistentVector of token values: taking one is O(1) and shares every chunk with
+// the machine and with the other mementos
+struct PersistentMemento
+{
+  PersistentVector<int> tokens;
+};
+
+// TokenMachine for long undo histories. A token's value is captured when it is added, so later changes
+// made through the caller's shared_ptr do not reach the machine or any memento; revert is O(1) too.
+struct PersistentTokenMachine
+{
+  PersistentVector<int> tokens;
+
+  PersistentMemento add_token(int value)
+  {
+    tokens.push_back(value);
+    return { tokens };
+  }
+
+  PersistentMemento add_token(const shared_ptr<Token>& token)
+  {
+    return add_token(token->value);
+  }
+
+  void revert(const PersistentMemento& m)
+  {
+    tokens = m.tokens;
+  }
+};
+
+// Read-only view of a whole file mapped into memory; an empty or missing file maps to nothing
+class MappedFile
+{
+  const unsigned char* bytes{ nullptr };
+  size_t length{ 0 };
+#ifdef _WIN32
+  HANDLE file{ INVALID_HANDLE_VALUE };
+  HANDLE mapping{ nullptr };
+#endif
+
+public:
+  explicit MappedFile(const string& path)
+  {
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+      FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size) || size.QuadPart == 0)
+      return;
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+      throw runtime_error("cannot map " + path);
+    bytes = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    length = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+      if (fd >= 0)
+        close(fd);
+      return;
+    }
+    void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED)
+      throw runtime_error("cannot map " + path);
+    bytes = static_cast<const unsigned char*>(address);
+    length = static_cast<size_t>(info.st_size);
+#endif
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile()
+  {
+#ifdef _WIN32
+    if (bytes != nullptr)
+      UnmapViewOfFile(bytes);
+    if (mapping != nullptr)
+      CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+      CloseHandle(file);
+#else
+    if (bytes != nullptr)
+      munmap(const_cast<unsigned char*>(bytes), length);
+#endif
+  }
+
+  const unsigned char* data() const { return bytes; }
+  size_t size() const { return length; }
+};
+
+// Append-only file of mementos. The file starts with a header (magic bytes and the checkpoint interval it
+// was written with), then every snapshot is one length-prefixed record: either a full checkpoint (written
+// every `checkpointInterval` snapshots) or a delta against the previous snapshot, i.e. how many leading
+// tokens are kept plus the values that follow. All numbers are LEB128 varints, token values zigzag-encoded
+// first. The in-memory index holds each record's offset, so load() maps the file and decodes only the
+// records from the nearest checkpoint up to the requested snapshot.
+class MementoLog
+{
+  enum RecordKind : unsigned char { checkpoint = 0, delta = 1 };
+
+  const string path;
+  const size_t checkpointInterval;
+  vector<uint64_t> offsets; // record offset of every snapshot, by id
+  uint64_t fileSize{ 0 };   // tracked ourselves, tellp() of an append stream is unreliable before the first write
+  vector<int> last;         // token values of the latest snapshot, the base for the next delta
+  ofstream out;
+
+public:
+  // Opens (or creates) the log at `path`. An existing log must have been written with the same checkpoint
+  // interval; a record cut short by a crash is dropped, together with anything after it.
+  MementoLog(const string& path, size_t checkpointInterval = 64)
+    : path(path), checkpointInterval(checkpointInterval == 0 ? 1 : checkpointInterval)
+  {
+    rebuild_index();
+    out.open(path, ios::binary | ios::app);
+    if (!out)
+      throw runtime_error("cannot open " + path);
+
+    if (fileSize == 0) {
+      string header = magic();
+      write_varint(header, this->checkpointInterval);
+      write(header);
+    }
+  }
+
+  size_t size() const { return offsets.size(); }
+
+  // writes the memento as a new snapshot and returns its id
+  size_t append(const Memento& m)
+  {
+    vector<int> values;
+    values.reserve(m.tokens.size());
+    for (const auto& token : m.tokens)
+      values.push_back(token.value);
+
+    string record;
+    if (offsets.size() % checkpointInterval == 0) {
+      record.push_back(static_cast<char>(checkpoint));
+      write_values(record, values, 0);
+    }
+    else {
+      size_t kept = 0;
+      while (kept < values.size() && kept < last.size() && values[kept] == last[kept])
+        ++kept;
+      record.push_back(static_cast<char>(delta));
+      write_varint(record, kept);
+      write_values(record, values, kept);
+    }
+
+    string frame;
+    write_varint(frame, record.size());
+    const uint64_t offset = fileSize;
+    write(frame + record);
+    offsets.push_back(offset);
+    last = move(values);
+    return offsets.size() - 1;
+  }
+
+  void flush()
+  {
+    out.flush();
+    if (!out)
+      throw runtime_error("cannot write " + path);
+  }
+
+  // reconstructs snapshot `id` from the file without reading the records before its checkpoint
+  Memento load(size_t id)
+  {
+    if (id >= offsets.size())
+      throw out_of_range("no memento " + to_string(id));
+    flush();
+
+    MappedFile file(path);
+    if (file.size() < fileSize)
+      throw runtime_error(path + " was truncated");
+    vector<int> values;
+    for (size_t record = id - id % checkpointInterval; record <= id; ++record)
+      if (!read_frame(file, offsets[record], values))
+        throw runtime_error("corrupt memento " + to_string(record) + " in " + path);
+
+    vector<Token> tokens;
+    tokens.reserve(values.size());
+    for (int value : values)
+      tokens.emplace_back(value);
+    return Memento(move(tokens));
+  }
+
+private:
+  static string magic()
+  {
+    return string("MLOG", 4);
+  }
+
+  void write(const string& bytes)
+  {
+    out << bytes;
+    if (!out)
+      throw runtime_error("cannot write " + path);
+    fileSize += bytes.size();
+  }
+
+  static void write_varint(string& buffer, uint64_t value)
+  {
+    while (value >= 0x80) {
+      buffer.push_back(static_cast<char>(value | 0x80));
+      value >>= 7;
+    }
+    buffer.push_back(static_cast<char>(value));
+  }
+
+  // false if the varint runs past `end` or is longer than any 64-bit value
+  static bool read_varint(const unsigned char*& cursor, const unsigned char* end, uint64_t& value)
+  {
+    value = 0;
+    for (int shift = 0; shift < 64 && cursor < end; shift += 7) {
+      unsigned char byte = *cursor++;
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (byte < 0x80)
+        return true;
+    }
+    return false;
+  }
+
+  static void write_values(string& buffer, const vector<int>& values, size_t from)
+  {
+    write_varint(buffer, values.size() - from);
+    for (size_t i = from; i < values.size(); ++i) {
+      int64_t value = values[i];
+      write_varint(buffer, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63)); // zigzag
+    }
+  }
+
+  // applies the record in [cursor, end) to `values`; false if it does not decode to exactly that range
+  static bool read_record(const unsigned char* cursor, const unsigned char* end, vector<int>& values)
+  {
+    if (cursor == end)
+      return false;
+    RecordKind kind = static_cast<RecordKind>(*cursor++);
+    uint64_t kept = 0, count = 0;
+    if (kind == delta) {
+      if (!read_varint(cursor, end, kept) || kept > values.size())
+        return false;
+    }
+    else if (kind != checkpoint) {
+      return false;
+    }
+    if (!read_varint(cursor, end, count) || count > static_cast<uint64_t>(end - cursor))
+      return false;
+
+    values.resize(static_cast<size_t>(kept));
+    for (; count > 0; --count) {
+      uint64_t encoded;
+      if (!read_varint(cursor, end, encoded))
+        return false;
+      values.push_back(static_cast<int>(static_cast<int64_t>(encoded >> 1) ^ -static_cast<int64_t>(encoded & 1)));
+    }
+    return cursor == end;
+  }
+
+  // decodes the length-prefixed record at `offset`; false if it is cut short or corrupt
+  static bool read_frame(const MappedFile& file, uint64_t offset, vector<int>& values)
+  {
+    const unsigned char* end = file.data() + file.size();
+    const unsigned char* cursor = file.data() + offset;
+    uint64_t length;
+    if (!read_varint(cursor, end, length) || length > static_cast<uint64_t>(end - cursor))
+      return false;
+    return read_record(cursor, cursor + length, values);
+  }
+
+  // After a restart: check the header, hop over the record frames to rebuild the index, then decode the
+  // tail of the history (from the last checkpoint) to get the base for the next delta. A torn header or
+  // final record is cut off the file, so the next append continues right after the last complete record.
+  void rebuild_index()
+  {
+    uint64_t complete = 0;
+    {
+      MappedFile file(path);
+      const unsigned char* begin = file.data();
+      const unsigned char* end = begin + file.size();
+      const unsigned char* cursor = begin;
+      const string expected = magic();
+
+      const size_t prefix = min(file.size(), expected.size());
+      if (!equal(begin, begin + prefix, expected.begin()))
+        throw runtime_error(path + " is not a memento log");
+      uint64_t interval = 0;
+      cursor += prefix;
+      if (prefix == expected.size() && read_varint(cursor, end, interval)) {
+        if (interval != checkpointInterval)
+          throw invalid_argument(path + " was written with checkpoint interval " + to_string(interval)
+            + ", not " + to_string(checkpointInterval));
+        complete = static_cast<uint64_t>(cursor - begin);
+
+        while (cursor < end) {
+          const unsigned char* record = cursor;
+          uint64_t length;
+          if (!read_varint(cursor, end, length) || length > static_cast<uint64_t>(end - cursor))
+            break;
+          cursor += length;
+          offsets.push_back(static_cast<uint64_t>(record - begin));
+          complete = static_cast<uint64_t>(cursor - begin);
+        }
+
+        if (!offsets.empty()) {
+          const size_t id = offsets.size() - 1;
+          for (size_t record = id - id % checkpointInterval; record <= id; ++record)
+            if (!read_frame(file, offsets[record], last))
+              throw runtime_error("corrupt memento " + to_string(record) + " in " + path);
+        }
+      }
+      fileSize = file.size();
+    }
+
+    if (complete < fileSize) {
+      truncate_file(complete);
+      fileSize = complete;
+    }
+  }
+
+  void truncate_file(uint64_t length) const
+  {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(length);
+    bool truncated = file != INVALID_HANDLE_VALUE && SetFilePointerEx(file, position, nullptr, FILE_BEGIN)
+      && SetEndOfFile(file);
+    if (file != INVALID_HANDLE_VALUE)
+      CloseHandle(file);
+#else
+    bool truncated = ::truncate(path.c_str(), static_cast<off_t>(length)) == 0;
+#endif
+    if (!truncated)
+      throw runtime_error("cannot truncate " + path);
+  }
+};
+
+// TokenMachine for one writer thread and many concurrent readers. Token values live in fixed-size chunks
+// referenced from a chunk table; a Version (size + table) is immutable once published through an atomic
+// pointer, and readers only ever look at positions below their version's size. The writer appends in
+// place while a chunk slot (or table slot) has never been visible to any version, and copies the chunk
+// and the table first otherwise (after a revert), so published versions never change under a reader.
+//
+// Readers do not touch reference counts: they announce the epoch they read in, and the writer keeps each
+// replaced version alive until every reader has moved past the epoch it was retired in.
+class ConcurrentTokenMachine
+{
+public:
+  static constexpr size_t chunk_size = 256;
+  static constexpr size_t max_readers = 64;
+
+  struct Chunk
+  {
+    array<int, chunk_size> values;
+    size_t filled{ 0 }; // slots ever written; writer only
+  };
+
+  struct Table
+  {
+    unique_ptr<shared_ptr<Chunk>[]> chunks;
+    size_t capacity;
+    size_t filled{ 0 }; // slots ever written; writer only
+
+    explicit Table(size_t capacity) : chunks(new shared_ptr<Chunk>[capacity]), capacity(capacity) {}
+  };
+
+  struct Version
+  {
+    size_t size;
+    shared_ptr<Table> table;
+
+    int operator[](size_t index) const
+    {
+      return table->chunks[index / chunk_size]->values[index % chunk_size];
+    }
+  };
+
+  struct Memento
+  {
+    shared_ptr<const Version> version;
+  };
+
+  // Handle a reader thread uses to read the current state; each one claims one of max_readers slots
+  class Reader
+  {
+    ConcurrentTokenMachine& machine;
+    size_t slot;
+
+  public:
+    explicit Reader(ConcurrentTokenMachine& machine) : machine(machine), slot(machine.claim_slot()) {}
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    ~Reader()
+    {
+      machine.slots[slot].taken.store(false, memory_order_release);
+    }
+
+    // calls f(const Version&) on a consistent view of the current state, valid only during the call
+    template <typename F>
+    auto read(F f) -> decltype(f(declval<const Version&>()))
+    {
+      auto& pinned = machine.slots[slot].pinned;
+      // acquire: seeing the epoch a publish() moved to means also seeing the version it published, so
+      // the load of `published` below can never return a version retired before the pinned epoch
+      pinned.store(machine.epoch.load(memory_order_acquire), memory_order_seq_cst);
+      struct Unpin
+      {
+        atomic<uint64_t>& pinned;
+        ~Unpin() { pinned.store(0, memory_order_release); }
+      } unpin{ pinned };
+      return f(*machine.published.load(memory_order_seq_cst));
+    }
+  };
+
+  ConcurrentTokenMachine()
+  {
+    auto initial = make_shared<const Version>(Version{ 0, make_shared<Table>(16) });
+    current = initial;
+    published.store(initial.get(), memory_order_release);
+  }
+
+  // Writer side
+
+  Memento add_token(int value)
+  {
+    const size_t index = current->size;
+    const size_t chunkIndex = index / chunk_size;
+    const size_t offset = index % chunk_size;
+    shared_ptr<Table> table = current->table;
+
+    if (chunkIndex < table->filled) {
+      if (offset < table->chunks[chunkIndex]->filled) {
+        // this slot may be visible to another version: copy the chunk up to it, and the table pointing to it
+        auto chunk = make_shared<Chunk>();
+        copy_n(table->chunks[chunkIndex]->values.begin(), offset, chunk->values.begin());
+        chunk->filled = offset;
+        table = copy_table(*table, chunkIndex, table->capacity);
+        table->chunks[chunkIndex] = move(chunk);
+        table->filled = chunkIndex + 1;
+      }
+    }
+    else {
+      if (chunkIndex == table->capacity)
+        table = copy_table(*table, chunkIndex, table->capacity * 2);
+      table->chunks[chunkIndex] = make_shared<Chunk>();
+      table->filled = chunkIndex + 1;
+    }
+
+    Chunk& chunk = *table->chunks[chunkIndex];
+    chunk.values[offset] = value;
+    chunk.filled = offset + 1;
+    publish(make_shared<const Version>(Version{ index + 1, move(table) }));
+    return { current };
+  }
+
+  Memento add_token(const shared_ptr<Token>& token)
+  {
+    return add_token(token->value);
+  }
+
+  void revert(const Memento& m)
+  {
+    publish(m.version);
+  }
+
+  Memento snapshot() const
+  {
+    return { current };
+  }
+
+  size_t size() const
+  {
+    return current->size;
+  }
+
+private:
+  struct ReaderSlot
+  {
+    atomic<uint64_t> pinned{ 0 }; // epoch the reader entered in, 0 when not reading
+    atomic<bool> taken{ false };
+    char padding[64 - sizeof(atomic<uint64_t>) - sizeof(atomic<bool>)]; // pinned epochs never share a cache line
+  };
+
+  static constexpr size_t reclaim_every = 64;
+
+  shared_ptr<const Version> current; // writer only
+  atomic<const Version*> published{ nullptr };
+  atomic<uint64_t> epoch{ 1 };
+  array<ReaderSlot, max_readers> slots;
+  deque<pair<uint64_t, shared_ptr<const Version>>> retired; // writer only, oldest first
+
+  size_t claim_slot()
+  {
+    for (size_t i = 0; i < max_readers; ++i) {
+      bool expected = false;
+      if (slots[i].taken.compare_exchange_strong(expected, true, memory_order_acquire))
+        return i;
+    }
+    throw runtime_error("too many concurrent readers");
+  }
+
+  // Copies the first `count` chunk pointers of a table; the chunks themselves stay shared
+  static shared_ptr<Table> copy_table(const Table& table, size_t count, size_t capacity)
+  {
+    auto copy = make_shared<Table>(capacity);
+    for (size_t i = 0; i < count; ++i)
+      copy->chunks[i] = table.chunks[i];
+    copy->filled = count;
+    return copy;
+  }
+
+  void publish(shared_ptr<const Version> version)
+  {
+    published.store(version.get(), memory_order_seq_cst);
+    retired.emplace_back(epoch.fetch_add(1, memory_order_seq_cst), move(current));
+    current = move(version);
+
+    if (retired.size() % reclaim_every == 0)
+      reclaim();
+  }
+
+  // drops the writer's references to versions no reader can still be looking at
+  void reclaim()
+  {
+    uint64_t oldestPinned = UINT64_MAX;
+    for (const auto& slot : slots) {
+      uint64_t pinned = slot.pinned.load(memory_order_seq_cst);
+      if (pinned != 0)
+        oldestPinned = min(oldestPinned, pinned);
+    }
+    while (!retired.empty() && retired.front().first < oldestPinned)
+      retired.pop_front();
+  }
+};
+
+// One writer keeps adding tokens (each token's value is its position, reverting to the empty state every
+// million tokens) while `readerCount` threads repeatedly read a consistent view; reports reads/sec
+void benchmark_concurrent_token_machine(size_t readerCount, chrono::milliseconds duration)
+{
+  ConcurrentTokenMachine machine;
+  auto empty = machine.snapshot();
+  atomic<bool> running{ true };
+  atomic<size_t> reads{ 0 }, inconsistent{ 0 };
+  size_t adds = 0;
+
+  vector<thread> readers;
+  for (size_t r = 0; r < readerCount; ++r) {
+    readers.emplace_back([&, r] {
+      ConcurrentTokenMachine::Reader reader(machine);
+      size_t localReads = 0, localInconsistent = 0;
+      size_t probe = r;
+      while (running.load(memory_order_relaxed)) {
+        bool consistent = reader.read([&](const ConcurrentTokenMachine::Version& view) {
+          if (view.size == 0)
+            return true;
+          probe = probe * 6364136223846793005ULL + 1442695040888963407ULL;
+          size_t index = static_cast<size_t>(probe >> 33) % view.size;
+          return view[view.size - 1] == static_cast<int>(view.size - 1) && view[index] == static_cast<int>(index);
+        });
+        ++localReads;
+        localInconsistent += consistent ? 0 : 1;
+      }
+      reads += localReads;
+      inconsistent += localInconsistent;
+    });
+  }
+
+  auto start = chrono::steady_clock::now();
+  while (chrono::steady_clock::now() - start < duration) {
+    for (int i = 0; i < 1000; ++i, ++adds) {
+      if (machine.size() == 1000000)
+        machine.revert(empty);
+      machine.add_token(static_cast<int>(machine.size()));
+    }
+  }
+  running = false;
+  for (auto& reader : readers)
+    reader.join();
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  cout << readerCount << " readers: " << static_cast<size_t>(reads / seconds) << " reads/sec, writer "
+    << static_cast<size_t>(adds / seconds) << " adds/sec" << (inconsistent ? " (INCONSISTENT)" : "") << "\n";
+}
+
+// Replays the same history on a PersistentTokenMachine and on a plain vector<Token>: every snapshot must
+// still hold its own values after later add_token/revert calls, across the trie depth changes at 32,
+// 1024 and 32768 tokens. Snapshot i of the first pass holds the first i + 1 values of `history`.
+bool persistent_machine_matches_vector(size_t count)
+{
+  PersistentTokenMachine machine;
+  vector<PersistentMemento> snapshots;
+  vector<Token> history;
+
+  auto matches = [](const PersistentVector<int>& tokens, const vector<Token>& values, size_t size) {
+    if (tokens.size() != size)
+      return false;
+    for (size_t i = 0; i < size; ++i)
+      if (tokens[i] != values[i].value)
+        return false;
+    return true;
+  };
+
+  for (size_t i = 0; i < count; ++i) {
+    auto token = make_shared<Token>(static_cast<int>(i * 7 - 3));
+    snapshots.push_back(machine.add_token(token));
+    history.push_back(*token);
+    token->value = -1; // must not reach the machine
+    if (machine.tokens[i] != history[i].value)
+      return false;
+  }
+
+  // branch off older states: revert and add different values, which must not leak into the shared chunks
+  for (size_t at : { count / 3, count / 2, size_t{ 31 }, size_t{ 32 }, size_t{ 1023 }, size_t{ 1024 } }) {
+    if (at >= count)
+      continue;
+    machine.revert(snapshots[at]);
+    vector<Token> branch(history.begin(), history.begin() + at + 1);
+    for (int i = 0; i < 100; ++i) {
+      machine.add_token(1000000 + i);
+      branch.emplace_back(1000000 + i);
+    }
+    if (!matches(machine.tokens, branch, branch.size()))
+      return false;
+  }
+
+  // a full comparison of every snapshot is quadratic, so long histories check the boundaries and a stride
+  for (size_t i = 0; i < count; ++i)
+    if ((i < 2100 || i % 1000 == 0 || i + 1 == count) && !matches(snapshots[i].tokens, history, i + 1))
+      return false;
+  return true;
+}
+
+// Writes a history of mementos (with reverts, so deltas both grow and shrink), reopens the log and checks
+// that reverting a TokenMachine to any loaded snapshot restores exactly the original tokens; appending
+// after the reopen must continue the same history, and a different checkpoint interval is rejected
+bool memento_log_round_trip(const string& path)
+{
+  remove(path.c_str());
+  TokenMachine machine;
+  vector<Memento> expected;
+  {
+    MementoLog log(path, 16);
+    for (int i = 0; i <= 88; ++i) {
+      expected.push_back(machine.add_token(i * 1000 - 5000));
+      log.append(expected.back());
+      if (i % 10 == 9) {
+        machine.revert(expected[expected.size() - 5]);
+        expected.push_back(Memento(machine.tokens));
+        log.append(expected.back());
+      }
+    }
+  }
+
+  auto restores = [&](MementoLog& log) {
+    if (log.size() != expected.size())
+      return false;
+    for (size_t id = 0; id < expected.size(); ++id) {
+      TokenMachine restored;
+      restored.revert(log.load(id));
+      if (restored.tokens.size() != expected[id].tokens.size())
+        return false;
+      for (size_t i = 0; i < restored.tokens.size(); ++i)
+        if (restored.tokens[i]->value != expected[id].tokens[i].value)
+          return false;
+    }
+    return true;
+  };
+
+  bool ok;
+  {
+    MementoLog log(path, 16);
+    ok = restores(log) && log.load(log.size() - 1).tokens.back().value == 88000 - 5000;
+    expected.push_back(machine.add_token(-1));
+    log.append(expected.back());
+  }
+  {
+    MementoLog log(path, 16);
+    ok = ok && restores(log);
+  }
+  try {
+    MementoLog log(path, 64);
+    ok = false;
+  }
+  catch (const invalid_argument&) {
+  }
+  remove(path.c_str());
+  return ok;
+}
+
+// Cuts the last record of a log short, as a crash in the middle of a write would: reopening keeps every
+// complete snapshot, drops the torn one and appends the next snapshot right after the last complete record
+bool memento_log_drops_torn_tail(const string& path)
+{
+  remove(path.c_str());
+  TokenMachine machine;
+  vector<Memento> expected;
+  {
+    MementoLog log(path, 4);
+    for (int i = 0; i < 10; ++i) {
+      expected.push_back(machine.add_token(i));
+      log.append(expected.back());
+    }
+  }
+
+  string bytes;
+  {
+    ifstream in(path, ios::binary);
+    bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+  }
+  {
+    ofstream torn(path, ios::binary | ios::trunc);
+    torn.write(bytes.data(), static_cast<streamsize>(bytes.size() - 2));
+  }
+
+  bool ok;
+  {
+    MementoLog log(path, 4);
+    ok = log.size() == expected.size() - 1 && log.load(log.size() - 1).tokens.size() == expected.size() - 1;
+    log.append(Memento(vector<Token>{ Token(42) }));
+  }
+  {
+    MementoLog log(path, 4);
+    ok = ok && log.size() == expected.size();
+    for (size_t id = 0; ok && id + 1 < expected.size(); ++id)
+      ok = log.load(id).tokens.size() == expected[id].tokens.size();
+    auto back = log.load(log.size() - 1);
+    ok = ok && back.tokens.size() == 1 && back.tokens[0].value == 42;
+  }
+  remove(path.c_str());
+  return ok;
+}
+
 int main()
 {
-    std::cout << "Hello World!\n";
+  cout << boolalpha << "persistent snapshots match vector<Token>: "
+    << (persistent_machine_matches_vector(40) && persistent_machine_matches_vector(1100)
+      && persistent_machine_matches_vector(33000)) << "\n";
+  cout << "memento log round trip: " << memento_log_round_trip("memento_check.log") << "\n";
+  cout << "memento log drops torn tail: " << memento_log_drops_torn_tail("memento_check.log") << "\n";
+
+  const size_t maxReaders = max(2u, thread::hardware_concurrency());
+  for (size_t readers = 1; readers <= maxReaders; readers *= 2)
+    benchmark_concurrent_token_machine(readers, chrono::milliseconds(500));
 }
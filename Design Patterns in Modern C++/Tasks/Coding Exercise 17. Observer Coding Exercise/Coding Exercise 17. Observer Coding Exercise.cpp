@@ -6,6 +6,15 @@
 
 #include <iostream>
 #include <vector>
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
+#include <atomic>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
 using namespace std;
 
 struct IRat {
@@ -44,8 +53,292 @@ struct Rat : IRat
   }
 };
 
+struct SwarmRat;
+
+// Pull-based variant: nobody is notified when a rat joins or leaves, each rat reads the swarm size from
+// the game when asked. Every rat remembers its index in `rats`, so leaving is an O(1) swap-remove.
+struct SwarmGame
+{
+  vector<SwarmRat*> rats;
+
+  int swarm_size() const
+  {
+    return static_cast<int>(rats.size());
+  }
+};
+
+struct SwarmRat
+{
+  SwarmGame& game;
+  size_t index;
+
+  SwarmRat(SwarmGame& game) : game(game), index(game.rats.size()) {
+    game.rats.push_back(this);
+  }
+
+  ~SwarmRat() {
+    SwarmRat* last = game.rats.back();
+    game.rats[index] = last; // Move the last rat into our slot
+    last->index = index;
+    game.rats.pop_back();
+  }
+
+  int attack() const {
+    return game.swarm_size();
+  }
+};
+
+// Push-based game that coalesces notifications: joins and leaves during a frame only record a change on
+// a lock-free stack (rats may be created and destroyed on any thread), and end_frame() applies all of them
+// and notifies every rat once. Between frames a rat's attack is the one computed at the last end_frame().
+// end_frame() runs on one thread at a time.
+//
+// end_frame() notifies rats through their pointers, so a rat must not be destroyed while that happens:
+// left() holds `frame` shared while it records the death and end_frame() holds it exclusively while it
+// drains the stack and notifies. A death is therefore either drained before the notifications (and the
+// rat is not notified) or waits until they are done; leaving rats never wait for each other.
+struct FrameGame
+{
+  vector<IRat*> rats; // frame thread only
+
+  FrameGame() = default;
+  FrameGame(const FrameGame&) = delete;
+  FrameGame& operator=(const FrameGame&) = delete;
+
+  ~FrameGame()
+  {
+    delete_changes(pending.exchange(nullptr));
+  }
+
+  void joined(IRat* rat)
+  {
+    push_change(rat, true);
+  }
+
+  // `rat` is only used as a key from here on, it may already be destroyed when the frame ends
+  void left(IRat* rat)
+  {
+    shared_lock<shared_timed_mutex> lock(frame);
+    push_change(rat, false);
+  }
+
+  void end_frame()
+  {
+    lock_guard<shared_timed_mutex> lock(frame);
+    Change* changes = pending.exchange(nullptr, memory_order_acquire);
+    if (changes == nullptr)
+      return;
+
+    // The stack holds the newest change first; apply them in the order they happened
+    Change* ordered = nullptr;
+    while (changes != nullptr) {
+      Change* next = changes->next;
+      changes->next = ordered;
+      ordered = changes;
+      changes = next;
+    }
+
+    for (Change* change = ordered; change != nullptr; change = change->next) {
+      if (change->joined) {
+        positions[change->rat] = rats.size();
+        rats.push_back(change->rat);
+      }
+      else {
+        auto position = positions.find(change->rat);
+        IRat* last = rats.back();
+        rats[position->second] = last; // swap-remove, the leaving rat may be gone already
+        positions[last] = position->second;
+        rats.pop_back();
+        positions.erase(change->rat);
+      }
+    }
+    delete_changes(ordered);
+
+    for (const auto rat : rats)
+      rat->notify();
+  }
+
+  int swarm_size() const
+  {
+    return static_cast<int>(rats.size());
+  }
+
+private:
+  struct Change
+  {
+    IRat* rat;
+    bool joined;
+    Change* next;
+  };
+
+  atomic<Change*> pending{ nullptr };
+  shared_timed_mutex frame; // shared by leaving rats, exclusive while a frame ends
+  unordered_map<const IRat*, size_t> positions; // frame thread only
+
+  void push_change(IRat* rat, bool joined)
+  {
+    Change* change = new Change{ rat, joined, pending.load(memory_order_relaxed) };
+    while (!pending.compare_exchange_weak(change->next, change, memory_order_release, memory_order_relaxed)) {}
+  }
+
+  static void delete_changes(Change* change)
+  {
+    while (change != nullptr) {
+      Change* next = change->next;
+      delete change;
+      change = next;
+    }
+  }
+};
+
+struct FrameRat : IRat
+{
+  FrameGame& game;
+  mutable atomic<int> attack{ 0 }; // set at the first end_frame() after the rat joined
+
+  FrameRat(FrameGame& game) : game(game) {
+    game.joined(this);
+  }
+
+  ~FrameRat() {
+    game.left(this);
+  }
+
+  void notify() const override {
+    attack.store(game.swarm_size(), memory_order_relaxed);
+  }
+};
+
+// `threads` threads each spawn `perThread` rats and kill every other one within one frame; after
+// end_frame() every surviving rat must see the whole surviving swarm
+bool frame_game_consistent(size_t threads, size_t perThread)
+{
+  FrameGame game;
+  vector<vector<unique_ptr<FrameRat>>> survivors(threads);
+  vector<thread> workers;
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      for (size_t i = 0; i < perThread; ++i) {
+        unique_ptr<FrameRat> rat(new FrameRat(game));
+        if (i % 2 == 0)
+          survivors[t].push_back(move(rat));
+      }
+    });
+  }
+  for (auto& worker : workers)
+    worker.join();
+  game.end_frame();
+
+  int expected = 0;
+  for (const auto& rats : survivors)
+    expected += static_cast<int>(rats.size());
+  for (const auto& rats : survivors)
+    for (const auto& rat : rats)
+      if (rat->attack != expected)
+        return false;
+  return game.swarm_size() == expected;
+}
+
+// `threads` threads keep spawning rats and killing random ones while the main thread ends frames as fast
+// as it can, so rats die in the middle of end_frame(); once the churn stops, the last frame must leave
+// every survivor with the final swarm size
+bool frame_game_survives_churn(size_t threads, chrono::milliseconds duration)
+{
+  FrameGame game;
+  atomic<bool> running{ true };
+  vector<vector<unique_ptr<FrameRat>>> survivors(threads);
+  vector<thread> workers;
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      mt19937 rng(static_cast<unsigned>(t));
+      auto& rats = survivors[t];
+      while (running.load(memory_order_relaxed)) {
+        if (rats.size() < 64 && rng() % 2 == 0)
+          rats.emplace_back(new FrameRat(game));
+        else if (!rats.empty())
+          rats.erase(rats.begin() + rng() % rats.size());
+      }
+    });
+  }
+
+  size_t frames = 0;
+  for (auto start = chrono::steady_clock::now(); chrono::steady_clock::now() - start < duration; ++frames)
+    game.end_frame();
+  running = false;
+  for (auto& worker : workers)
+    worker.join();
+  game.end_frame();
+
+  int expected = 0;
+  for (const auto& rats : survivors)
+    expected += static_cast<int>(rats.size());
+  for (const auto& rats : survivors)
+    for (const auto& rat : rats)
+      if (rat->attack != expected)
+        return false;
+  return frames > 0 && game.swarm_size() == expected;
+}
+
+// Spawns and kills rats in the same random order in both games and compares every live rat's attack
+bool swarm_matches_notifications(size_t steps)
+{
+  mt19937 rng(11);
+  Game game;
+  SwarmGame swarm;
+  vector<unique_ptr<Rat>> rats;
+  vector<unique_ptr<SwarmRat>> swarmRats;
+
+  for (size_t step = 0; step < steps; ++step) {
+    if (rats.empty() || rng() % 3 != 0) {
+      rats.emplace_back(new Rat(game));
+      swarmRats.emplace_back(new SwarmRat(swarm));
+    }
+    else {
+      size_t victim = rng() % rats.size();
+      rats.erase(rats.begin() + victim);
+      swarmRats.erase(swarmRats.begin() + victim);
+    }
+
+    for (size_t i = 0; i < rats.size(); ++i)
+      if (rats[i]->attack != swarmRats[i]->attack())
+        return false;
+  }
+  return true;
+}
+
+template <typename GameType>
+void end_frame_if_any(GameType&) {}
+
+void end_frame_if_any(FrameGame& game)
+{
+  game.end_frame();
+}
+
+// Time to spawn `count` rats and then kill them all, in spawn order
+template <typename GameType, typename RatType>
+double time_spawn_and_kill(size_t count)
+{
+  auto start = chrono::steady_clock::now();
+  {
+    GameType game;
+    {
+      vector<unique_ptr<RatType>> rats;
+      for (size_t i = 0; i < count; ++i)
+        rats.emplace_back(new RatType(game));
+      end_frame_if_any(game);
+    }
+    end_frame_if_any(game);
+  }
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
 
 int main()
 {
-    std::cout << "Hello World!\n";
+  cout << "swarm matches notifications: " << boolalpha << swarm_matches_notifications(3000) << "\n";
+  cout << "20000 rats, notifications: " << time_spawn_and_kill<Game, Rat>(20000) << " ms\n";
+  cout << "20000 rats, swarm counter: " << time_spawn_and_kill<SwarmGame, SwarmRat>(20000) << " ms\n";
+  cout << "1000000 rats, swarm counter: " << time_spawn_and_kill<SwarmGame, SwarmRat>(1000000) << " ms\n";
+  cout << "20000 rats, one frame: " << time_spawn_and_kill<FrameGame, FrameRat>(20000) << " ms\n";
+  cout << "frame game consistent across threads: " << frame_game_consistent(4, 10000) << "\n";
+  cout << "frame game survives churn: " << frame_game_survives_churn(4, chrono::milliseconds(300)) << "\n";
 }
\ No newline at end of file
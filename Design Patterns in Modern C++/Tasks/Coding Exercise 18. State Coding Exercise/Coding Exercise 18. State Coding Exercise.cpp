@@ -23,6 +23,12 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <queue>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
 using namespace std;
 
 class CombinationLock
@@ -60,8 +66,349 @@ public:
   }
 };
 
+// Same lock driven by a transition table over integer states: 0 is LOCKED, 1..n-1 is the number of digits
+// entered so far, n is OPEN and n + 1 is ERROR. A keystroke is one table lookup; the status string is only
+// built when asked for, from the matched prefix of the combination. Entering a digit after ERROR starts a
+// new attempt, and an open lock ignores further digits until lock() is called. An empty combination would
+// make LOCKED and OPEN the same state, so it is rejected.
+class TableCombinationLock
+{
+  vector<int> combination;
+  vector<uint32_t> transitions; // transitions[state * 10 + digit]
+  uint32_t state{ 0 };
+
+public:
+  TableCombinationLock(const vector<int>& combination) : combination(combination)
+  {
+    if (combination.empty())
+      throw invalid_argument("a combination needs at least one digit");
+    const uint32_t open = open_state(), error = open + 1;
+    transitions.resize((error + 1) * 10);
+    for (uint32_t from = 0; from <= error; ++from) {
+      const uint32_t pos = from == error ? 0 : from; // ERROR retries from the first digit
+      for (int digit = 0; digit < 10; ++digit)
+        transitions[from * 10 + digit] = from == open ? open : combination[pos] == digit ? pos + 1 : error;
+    }
+  }
+
+  void enter_digit(int digit)
+  {
+    state = digit >= 0 && digit < 10 ? transitions[state * 10 + digit] : open_state() + 1;
+  }
+
+  bool is_open() const { return state == open_state(); }
+
+  void lock() { state = 0; }
+
+  string status() const
+  {
+    if (state == 0)
+      return "LOCKED";
+    if (state == open_state())
+      return "OPEN";
+    if (state == open_state() + 1)
+      return "ERROR";
+
+    string entered;
+    for (uint32_t i = 0; i < state; ++i)
+      entered += to_string(combination[i]);
+    return entered;
+  }
+
+private:
+  uint32_t open_state() const { return static_cast<uint32_t>(combination.size()); }
+};
+
+// The same state machine for a combination fixed at compile time: no heap, and the comparisons
+// run against a constant array
+template <int... Digits>
+class StaticCombinationLock
+{
+  static_assert(sizeof...(Digits) > 0, "a combination needs at least one digit");
+  static constexpr int combination[] = { Digits... };
+  static constexpr uint32_t open = sizeof...(Digits);
+  static constexpr uint32_t error = open + 1;
+  uint32_t state{ 0 };
+
+public:
+  void enter_digit(int digit)
+  {
+    if (state == open)
+      return;
+    const uint32_t pos = state == error ? 0 : state;
+    state = combination[pos] == digit ? pos + 1 : error;
+  }
+
+  bool is_open() const { return state == open; }
+
+  void lock() { state = 0; }
+
+  string status() const
+  {
+    if (state == 0)
+      return "LOCKED";
+    if (state == open)
+      return "OPEN";
+    if (state == error)
+      return "ERROR";
+
+    string entered;
+    for (uint32_t i = 0; i < state; ++i)
+      entered += to_string(combination[i]);
+    return entered;
+  }
+};
+
+template <int... Digits>
+constexpr int StaticCombinationLock<Digits...>::combination[];
+
+// Watches one continuous digit stream for thousands of combinations at once. Unlike a single
+// CombinationLock, which throws away its progress on a wrong digit, a keypad watching a stream opens a lock
+// whenever the most recent digits equal its combination, so overlapping attempts are not missed. All
+// combinations are compiled into one Aho-Corasick automaton with a full transition table over the ten
+// digits: each digit is one lookup, plus a walk over the locks that open at that point. An empty
+// combination would have to open before every digit, so it is rejected.
+class MultiCombinationMatcher
+{
+  static constexpr uint32_t none = UINT32_MAX;
+
+  vector<uint32_t> transitions;  // transitions[state * 10 + digit]
+  vector<uint32_t> outputLink;   // nearest proper suffix state at which some lock opens
+  vector<uint32_t> outputBegin;  // locks opening exactly at state s: outputs[outputBegin[s]..outputBegin[s + 1])
+  vector<uint32_t> outputs;
+  uint32_t state{ 0 };
+  size_t position{ 0 };
+
+public:
+  MultiCombinationMatcher(const vector<vector<int>>& combinations)
+  {
+    // trie of all combinations; state 0 is the root
+    vector<vector<uint32_t>> endsAt(1);
+    transitions.assign(10, none);
+    for (uint32_t lock = 0; lock < combinations.size(); ++lock) {
+      if (combinations[lock].empty())
+        throw invalid_argument("combination " + to_string(lock) + " has no digits");
+      uint32_t s = 0;
+      for (int digit : combinations[lock]) {
+        if (transitions[s * 10 + digit] == none) {
+          transitions[s * 10 + digit] = static_cast<uint32_t>(endsAt.size());
+          endsAt.emplace_back();
+          transitions.resize(endsAt.size() * 10, none);
+        }
+        s = transitions[s * 10 + digit];
+      }
+      endsAt[s].push_back(lock);
+    }
+
+    // breadth-first: fill missing transitions from the failure state and chain the output links
+    const size_t stateCount = endsAt.size();
+    vector<uint32_t> failure(stateCount, 0);
+    outputLink.assign(stateCount, none);
+    queue<uint32_t> pending;
+    for (int digit = 0; digit < 10; ++digit) {
+      uint32_t& next = transitions[digit];
+      if (next == none)
+        next = 0;
+      else
+        pending.push(next);
+    }
+    while (!pending.empty()) {
+      uint32_t s = pending.front();
+      pending.pop();
+      for (int digit = 0; digit < 10; ++digit) {
+        uint32_t& next = transitions[s * 10 + digit];
+        const uint32_t fallback = transitions[failure[s] * 10 + digit];
+        if (next == none) {
+          next = fallback;
+          continue;
+        }
+        failure[next] = fallback;
+        outputLink[next] = !endsAt[fallback].empty() ? fallback : outputLink[fallback];
+        pending.push(next);
+      }
+    }
+
+    outputBegin.reserve(stateCount + 1);
+    for (const auto& locks : endsAt) {
+      outputBegin.push_back(static_cast<uint32_t>(outputs.size()));
+      outputs.insert(outputs.end(), locks.begin(), locks.end());
+    }
+    outputBegin.push_back(static_cast<uint32_t>(outputs.size()));
+  }
+
+  // Feeds digits continuing the stream; calls onOpen(lock, position) for every lock whose combination
+  // ends at that stream position. Anything but 0-9 breaks every attempt in progress.
+  template <typename OnOpen>
+  void feed(const int* digits, size_t count, OnOpen onOpen)
+  {
+    for (size_t i = 0; i < count; ++i, ++position) {
+      const int digit = digits[i];
+      if (digit < 0 || digit > 9) {
+        state = 0;
+        continue;
+      }
+      state = transitions[state * 10 + digit];
+      for (uint32_t s = outputBegin[state] != outputBegin[state + 1] ? state : outputLink[state]; s != none; s = outputLink[s])
+        for (uint32_t o = outputBegin[s]; o < outputBegin[s + 1]; ++o)
+          onOpen(outputs[o], position);
+    }
+  }
+
+  void reset()
+  {
+    state = 0;
+    position = 0;
+  }
+};
+
+constexpr uint32_t MultiCombinationMatcher::none;
+
+string status_of(const CombinationLock& lock) { return lock.status; }
+
+template <typename Lock>
+string status_of(const Lock& lock) { return lock.status(); }
+
+// The exercise's status-string scenarios: correct entry and a wrong second digit
+template <typename Lock>
+bool status_semantics_hold(Lock correct, Lock wrong)
+{
+  bool ok = status_of(correct) == "LOCKED";
+  correct.enter_digit(1);
+  ok = ok && status_of(correct) == "1";
+  correct.enter_digit(2);
+  ok = ok && status_of(correct) == "12";
+  correct.enter_digit(3);
+  ok = ok && status_of(correct) == "OPEN";
+
+  wrong.enter_digit(1);
+  wrong.enter_digit(5);
+  return ok && status_of(wrong) == "ERROR";
+}
+
+bool is_open(const CombinationLock& lock) { return lock.status == "OPEN"; }
+
+template <typename Lock>
+bool is_open(const Lock& lock) { return lock.is_open(); }
+
+// CombinationLock cannot be locked again, so it is replaced by a new one
+template <typename MakeLock>
+void relock(CombinationLock& lock, MakeLock make) { lock = make(); }
+
+template <typename Lock, typename MakeLock>
+void relock(Lock& lock, MakeLock) { lock.lock(); }
+
+// Feeds the same digit stream (mostly correct entries with some typos) to a lock, relocking it whenever it
+// opens; reports digits/sec and how many times it opened
+template <typename Lock, typename MakeLock>
+void benchmark_lock(const char* name, const vector<int>& digits, MakeLock make)
+{
+  Lock lock = make();
+  size_t opened = 0;
+  auto start = chrono::steady_clock::now();
+  for (int digit : digits) {
+    lock.enter_digit(digit);
+    if (is_open(lock)) {
+      ++opened;
+      relock(lock, make);
+    }
+  }
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  cout << name << ": " << static_cast<size_t>(digits.size() / elapsed.count()) << " digits/sec, opened " << opened << " times\n";
+}
+
+// An empty combination is rejected up front rather than leaving a lock that is LOCKED and OPEN at once
+bool empty_combination_rejected()
+{
+  try {
+    TableCombinationLock lock({});
+    return false;
+  }
+  catch (const invalid_argument&) {
+  }
+  try {
+    MultiCombinationMatcher matcher({ { 1, 2 }, {} });
+    return false;
+  }
+  catch (const invalid_argument&) {
+    return true;
+  }
+}
+
+// Compares the matcher against checking every combination against the most recent digits
+bool matcher_matches_naive(const vector<vector<int>>& combinations, const vector<int>& digits)
+{
+  vector<size_t> expected(combinations.size()), found(combinations.size());
+  for (size_t end = 0; end < digits.size(); ++end)
+    for (size_t lock = 0; lock < combinations.size(); ++lock) {
+      const auto& combination = combinations[lock];
+      if (combination.size() <= end + 1 && equal(combination.begin(), combination.end(), digits.begin() + (end + 1 - combination.size())))
+        ++expected[lock];
+    }
+
+  MultiCombinationMatcher matcher(combinations);
+  matcher.feed(digits.data(), digits.size(), [&](uint32_t lock, size_t) { ++found[lock]; });
+  return expected == found;
+}
+
+// Digits/sec over one random stream as the number of combinations (4 to 8 digits each) grows
+void benchmark_matcher(const vector<int>& digits)
+{
+  mt19937 rng(17);
+  for (size_t count : { 10, 100, 1000, 10000, 100000 }) {
+    vector<vector<int>> combinations(count);
+    for (auto& combination : combinations)
+      for (size_t length = 4 + rng() % 5; length > 0; --length)
+        combination.push_back(static_cast<int>(rng() % 10));
+
+    MultiCombinationMatcher matcher(combinations);
+    size_t opened = 0;
+    auto start = chrono::steady_clock::now();
+    matcher.feed(digits.data(), digits.size(), [&](uint32_t, size_t) { ++opened; });
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    cout << count << " combinations, automaton: " << static_cast<size_t>(digits.size() / elapsed.count())
+      << " digits/sec, " << opened << " opens";
+
+    // the per-lock alternative, on a shorter prefix of the stream
+    if (count <= 1000) {
+      vector<TableCombinationLock> locks(combinations.begin(), combinations.end());
+      const size_t prefix = digits.size() / 20;
+      start = chrono::steady_clock::now();
+      for (size_t i = 0; i < prefix; ++i)
+        for (auto& lock : locks) {
+          lock.enter_digit(digits[i]);
+          if (lock.is_open())
+            lock.lock();
+        }
+      elapsed = chrono::steady_clock::now() - start;
+      cout << "; one lock at a time: " << static_cast<size_t>(prefix / elapsed.count()) << " digits/sec";
+    }
+    cout << "\n";
+  }
+}
 
 int main()
 {
-    std::cout << "Hello World!\n";
+  cout << boolalpha << "status semantics: original "
+    << status_semantics_hold(CombinationLock({ 1, 2, 3 }), CombinationLock({ 1, 2, 3 }))
+    << ", table " << status_semantics_hold(TableCombinationLock({ 1, 2, 3 }), TableCombinationLock({ 1, 2, 3 }))
+    << ", static " << status_semantics_hold(StaticCombinationLock<1, 2, 3>(), StaticCombinationLock<1, 2, 3>()) << "\n";
+  cout << "empty combination rejected: " << empty_combination_rejected() << "\n";
+
+  const vector<int> combination{ 4, 8, 1, 5, 1, 6 };
+  mt19937 rng(5);
+  vector<int> digits(20000000);
+  for (size_t i = 0; i < digits.size(); ++i)
+    digits[i] = rng() % 20 == 0 ? static_cast<int>(rng() % 10) : combination[i % combination.size()];
+
+  benchmark_lock<CombinationLock>("original", digits, [&] { return CombinationLock(combination); });
+  benchmark_lock<TableCombinationLock>("table   ", digits, [&] { return TableCombinationLock(combination); });
+  benchmark_lock<StaticCombinationLock<4, 8, 1, 5, 1, 6>>("static  ", digits, [] { return StaticCombinationLock<4, 8, 1, 5, 1, 6>(); });
+
+  vector<int> randomDigits(digits.size());
+  for (auto& digit : randomDigits)
+    digit = static_cast<int>(rng() % 10);
+  cout << "automaton matches naive: "
+    << matcher_matches_naive({ { 1, 2, 3 }, { 2, 3 }, { 1, 2, 1, 2 }, { 3 }, { 1, 2, 3 }, { 9, 9, 9 } },
+      vector<int>(randomDigits.begin(), randomDigits.begin() + 100000)) << "\n";
+  benchmark_matcher(randomDigits);
 }
\ No newline at end of file
@@ -1,4 +1,4 @@
-Str/*ategy Coding Exercise
+/*Strategy Coding Exercise
 Consider the quadratic equationand its canonical solution :
 
 The part b ^ 2 - 4 * a * c is called the discriminant.Suppose we want to provide an API with two different strategies for calculating the discriminant :
@@ -12,6 +12,30 @@ Please implement both of these strategies as well as the equation solver itself.
 #include <complex>
 #include <tuple>
 #include <cmath>
+#include <random>
+#include <chrono>
+#include <limits>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
 struct DiscriminantStrategy
@@ -62,8 +86,422 @@ public:
   }
 };
 
+// Roots of many equations in structure-of-arrays form: the + root is x1, the - root is x2
+struct QuadraticRoots
+{
+  vector<double> x1_real, x1_imag, x2_real, x2_imag;
+
+  explicit QuadraticRoots(size_t count) : x1_real(count), x1_imag(count), x2_real(count), x2_imag(count) {}
+};
+
+// Solves a[i]x^2 + b[i]x + c[i] = 0 for whole arrays, producing exactly what QuadraticEquationSolver::solve
+// gives with the same strategy (NaN roots included). The strategy is a template argument and its
+// calculate_discriminant is called through the static type, so there is no virtual call per equation and
+// the call inlines. The loop runs 8 or 4 equations at a time when the compiler targets AVX-512 or AVX2
+// (/arch:AVX512, /arch:AVX2): the discriminants still come from the strategy, lane by lane, and the
+// square roots, divisions and blends run on vectors. Otherwise it falls back to a branch-free scalar loop.
+template <typename Strategy>
+class BatchQuadraticEquationSolver
+{
+public:
+  void solve(const double* a, const double* b, const double* c, size_t count, QuadraticRoots& roots) const
+  {
+    size_t i = 0;
+#if defined(__AVX512F__)
+    for (; i + 8 <= count; i += 8)
+      solve8(a + i, b + i, c + i, roots, i);
+#elif defined(__AVX2__)
+    for (; i + 4 <= count; i += 4)
+      solve4(a + i, b + i, c + i, roots, i);
+#endif
+    for (; i < count; ++i)
+      solve1(a[i], b[i], c[i], roots, i);
+  }
+
+  QuadraticRoots solve(const vector<double>& a, const vector<double>& b, const vector<double>& c) const
+  {
+    QuadraticRoots roots(a.size());
+    solve(a.data(), b.data(), c.data(), a.size(), roots);
+    return roots;
+  }
+
+private:
+  static double discriminant(double a, double b, double c)
+  {
+    Strategy strategy;
+    return strategy.Strategy::calculate_discriminant(a, b, c); // qualified, so not a virtual call
+  }
+
+  static void solve1(double a, double b, double c, QuadraticRoots& roots, size_t i)
+  {
+    const double discri = discriminant(a, b, c);
+    const double denominator = 2 * a;
+    const double real = isnan(discri) ? numeric_limits<double>::quiet_NaN() : -(b / denominator);
+    const double imag = sqrt(abs(discri)) / denominator;
+    const bool positive = discri > 0;
+
+    roots.x1_real[i] = positive ? real + imag : real;
+    roots.x1_imag[i] = positive ? 0 : imag;
+    roots.x2_real[i] = positive ? real + -imag : real;
+    roots.x2_imag[i] = positive ? 0 : -imag;
+  }
+
+#if defined(__AVX2__) && !defined(__AVX512F__)
+  static void solve4(const double* a, const double* b, const double* c, QuadraticRoots& roots, size_t i)
+  {
+    const __m256d va = _mm256_loadu_pd(a), vb = _mm256_loadu_pd(b);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d signBit = _mm256_set1_pd(-0.0);
+    const __m256d nan = _mm256_set1_pd(numeric_limits<double>::quiet_NaN());
+
+    // same operations as solve1 on the same discriminants, so the results are bit-identical
+    alignas(32) double discriminants[4];
+    for (size_t lane = 0; lane < 4; ++lane)
+      discriminants[lane] = discriminant(a[lane], b[lane], c[lane]);
+    const __m256d discri = _mm256_load_pd(discriminants);
+    const __m256d denominator = _mm256_mul_pd(_mm256_set1_pd(2), va);
+    const __m256d real = _mm256_blendv_pd(_mm256_xor_pd(_mm256_div_pd(vb, denominator), signBit), nan,
+      _mm256_cmp_pd(discri, discri, _CMP_UNORD_Q));
+    const __m256d imag = _mm256_div_pd(_mm256_sqrt_pd(_mm256_andnot_pd(signBit, discri)), denominator);
+    const __m256d negImag = _mm256_xor_pd(imag, signBit);
+    const __m256d positive = _mm256_cmp_pd(discri, zero, _CMP_GT_OQ);
+
+    _mm256_storeu_pd(&roots.x1_real[i], _mm256_blendv_pd(real, _mm256_add_pd(real, imag), positive));
+    _mm256_storeu_pd(&roots.x1_imag[i], _mm256_blendv_pd(imag, zero, positive));
+    _mm256_storeu_pd(&roots.x2_real[i], _mm256_blendv_pd(real, _mm256_add_pd(real, negImag), positive));
+    _mm256_storeu_pd(&roots.x2_imag[i], _mm256_blendv_pd(negImag, zero, positive));
+  }
+#endif
+
+#if defined(__AVX512F__)
+  static void solve8(const double* a, const double* b, const double* c, QuadraticRoots& roots, size_t i)
+  {
+    const __m512d va = _mm512_loadu_pd(a), vb = _mm512_loadu_pd(b);
+    const __m512d zero = _mm512_setzero_pd();
+    const __m512i signBit = _mm512_set1_epi64(numeric_limits<long long>::min());
+    const __m512d nan = _mm512_set1_pd(numeric_limits<double>::quiet_NaN());
+
+    alignas(64) double discriminants[8];
+    for (size_t lane = 0; lane < 8; ++lane)
+      discriminants[lane] = discriminant(a[lane], b[lane], c[lane]);
+    const __m512d discri = _mm512_load_pd(discriminants);
+    const __m512d denominator = _mm512_mul_pd(_mm512_set1_pd(2), va);
+    const __m512d negQuotient = _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(_mm512_div_pd(vb, denominator)), signBit));
+    const __m512d real = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(discri, discri, _CMP_UNORD_Q), negQuotient, nan);
+    const __m512d absDiscri = _mm512_castsi512_pd(_mm512_andnot_si512(signBit, _mm512_castpd_si512(discri)));
+    const __m512d imag = _mm512_div_pd(_mm512_sqrt_pd(absDiscri), denominator);
+    const __m512d negImag = _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(imag), signBit));
+    const __mmask8 positive = _mm512_cmp_pd_mask(discri, zero, _CMP_GT_OQ);
+
+    _mm512_storeu_pd(&roots.x1_real[i], _mm512_mask_blend_pd(positive, real, _mm512_add_pd(real, imag)));
+    _mm512_storeu_pd(&roots.x1_imag[i], _mm512_mask_blend_pd(positive, imag, zero));
+    _mm512_storeu_pd(&roots.x2_real[i], _mm512_mask_blend_pd(positive, real, _mm512_add_pd(real, negImag)));
+    _mm512_storeu_pd(&roots.x2_imag[i], _mm512_mask_blend_pd(positive, negImag, zero));
+  }
+#endif
+};
+
+bool same_root(double expected, double actual)
+{
+  return expected == actual || (isnan(expected) && isnan(actual));
+}
+
+// Solves `count` random equations one by one through the virtual strategy and as a batch, checks the
+// results agree and reports equations/sec for both
+template <typename Strategy>
+void benchmark_batch_solver(const char* name, size_t count)
+{
+  mt19937_64 rng(23);
+  uniform_real_distribution<double> coefficient(-100, 100);
+  vector<double> a(count), b(count), c(count);
+  for (size_t i = 0; i < count; ++i) {
+    a[i] = coefficient(rng);
+    b[i] = coefficient(rng);
+    c[i] = i % 16 == 0 ? b[i] * b[i] / (4 * a[i]) : coefficient(rng); // some zero discriminants too
+  }
+
+  Strategy strategy;
+  QuadraticEquationSolver solver(strategy);
+  vector<tuple<complex<double>, complex<double>>> scalar(count);
+  auto start = chrono::steady_clock::now();
+  for (size_t i = 0; i < count; ++i)
+    scalar[i] = solver.solve(a[i], b[i], c[i]);
+  chrono::duration<double> scalarTime = chrono::steady_clock::now() - start;
+
+  BatchQuadraticEquationSolver<Strategy> batchSolver;
+  QuadraticRoots roots(count);
+  start = chrono::steady_clock::now();
+  batchSolver.solve(a.data(), b.data(), c.data(), count, roots);
+  chrono::duration<double> batchTime = chrono::steady_clock::now() - start;
+
+  bool identical = true;
+  for (size_t i = 0; i < count && identical; ++i) {
+    const auto& x1 = get<0>(scalar[i]);
+    const auto& x2 = get<1>(scalar[i]);
+    identical = same_root(x1.real(), roots.x1_real[i]) && same_root(x1.imag(), roots.x1_imag[i])
+      && same_root(x2.real(), roots.x2_real[i]) && same_root(x2.imag(), roots.x2_imag[i]);
+  }
+
+  cout << name << ": scalar " << static_cast<size_t>(count / scalarTime.count()) << " equations/sec, batch "
+    << static_cast<size_t>(count / batchTime.count()) << " equations/sec" << (identical ? "" : " (MISMATCH)") << "\n";
+}
+
+// Whole input file mapped read-only, so workers read their chunks straight from the page cache
+class MappedInput
+{
+  const char* bytes{ nullptr };
+  size_t length{ 0 };
+#ifdef _WIN32
+  HANDLE file{ INVALID_HANDLE_VALUE }, mapping{ nullptr };
+#endif
+
+public:
+  explicit MappedInput(const string& path)
+  {
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER size;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size))
+      throw runtime_error("cannot open " + path);
+    if (size.QuadPart == 0)
+      return;
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    bytes = mapping ? static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    if (bytes == nullptr)
+      throw runtime_error("cannot map " + path);
+    length = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+      if (fd >= 0)
+        close(fd);
+      throw runtime_error("cannot open " + path);
+    }
+    length = static_cast<size_t>(info.st_size);
+    void* address = length ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+    close(fd);
+    if (address == MAP_FAILED)
+      throw runtime_error("cannot map " + path);
+    bytes = static_cast<const char*>(address);
+    if (bytes != nullptr)
+      madvise(address, length, MADV_SEQUENTIAL);
+#endif
+  }
+
+  MappedInput(const MappedInput&) = delete;
+  MappedInput& operator=(const MappedInput&) = delete;
+
+  ~MappedInput()
+  {
+#ifdef _WIN32
+    if (bytes != nullptr)
+      UnmapViewOfFile(bytes);
+    if (mapping != nullptr)
+      CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+      CloseHandle(file);
+#else
+    if (bytes != nullptr)
+      munmap(const_cast<char*>(bytes), length);
+#endif
+  }
+
+  const char* data() const { return bytes; }
+  size_t size() const { return length; }
+};
+
+struct PipelineStats
+{
+  size_t equations{ 0 };
+  size_t bytesRead{ 0 }, bytesWritten{ 0 };
+  double seconds{ 0 };
+  double computeSeconds{ 0 }; // summed over workers
+  double writeSeconds{ 0 };   // time the writer spent inside write calls
+};
+
+// Solves every equation of a binary file of (a, b, c) double triples and writes (x1 real, x1 imag, x2 real,
+// x2 imag) for each one to `output`, in input order. Workers take chunks of `chunkEquations` from the
+// mapped input, unpack them into arrays and run the batch solver; the calling thread writes finished chunks
+// in order. At most two chunks per worker are in flight, which bounds memory and keeps the writer fed.
+template <typename Strategy>
+PipelineStats solve_file(const string& input, const string& output, size_t threadCount = thread::hardware_concurrency(),
+  size_t chunkEquations = 1 << 16)
+{
+  using Clock = chrono::steady_clock;
+  const auto start = Clock::now();
+  threadCount = max<size_t>(1, threadCount);
+  chunkEquations = max<size_t>(1, chunkEquations);
+
+  MappedInput in(input);
+  ofstream out(output, ios::binary | ios::trunc);
+  if (!out)
+    throw runtime_error("cannot create " + output);
+  if (in.size() % (3 * sizeof(double)) != 0)
+    throw runtime_error(input + " is not a whole number of (a, b, c) triples");
+
+  PipelineStats stats;
+  stats.equations = in.size() / (3 * sizeof(double));
+  stats.bytesRead = in.size();
+  const size_t chunkCount = (stats.equations + chunkEquations - 1) / chunkEquations;
+  const size_t maxInFlight = 2 * threadCount;
+
+  vector<vector<double>> results(chunkCount);
+  vector<bool> done(chunkCount, false);
+  size_t written = 0;
+  mutex mtx;
+  condition_variable chunkDone, chunkWritten;
+  atomic<size_t> nextChunk{ 0 };
+  atomic<long long> computeNanos{ 0 };
+
+  auto work = [&] {
+    BatchQuadraticEquationSolver<Strategy> solver;
+    vector<double> a, b, c;
+    QuadraticRoots roots(chunkEquations);
+    for (size_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) {
+      {
+        unique_lock<mutex> lock(mtx);
+        chunkWritten.wait(lock, [&] { return chunk < written + maxInFlight; });
+      }
+
+      const auto computeStart = Clock::now();
+      const size_t first = chunk * chunkEquations;
+      const size_t count = min(chunkEquations, stats.equations - first);
+      const double* coefficients = reinterpret_cast<const double*>(in.data()) + 3 * first;
+      a.resize(count);
+      b.resize(count);
+      c.resize(count);
+      for (size_t i = 0; i < count; ++i) {
+        a[i] = coefficients[3 * i];
+        b[i] = coefficients[3 * i + 1];
+        c[i] = coefficients[3 * i + 2];
+      }
+      solver.solve(a.data(), b.data(), c.data(), count, roots);
+
+      vector<double> result(4 * count);
+      for (size_t i = 0; i < count; ++i) {
+        result[4 * i] = roots.x1_real[i];
+        result[4 * i + 1] = roots.x1_imag[i];
+        result[4 * i + 2] = roots.x2_real[i];
+        result[4 * i + 3] = roots.x2_imag[i];
+      }
+      computeNanos += chrono::duration_cast<chrono::nanoseconds>(Clock::now() - computeStart).count();
+
+      lock_guard<mutex> lock(mtx);
+      results[chunk] = move(result);
+      done[chunk] = true;
+      chunkDone.notify_all();
+    }
+  };
+
+  vector<thread> workers;
+  for (size_t t = 0; t < threadCount; ++t)
+    workers.emplace_back(work);
+
+  for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+    vector<double> result;
+    {
+      unique_lock<mutex> lock(mtx);
+      chunkDone.wait(lock, [&] { return done[chunk]; });
+      result = move(results[chunk]);
+    }
+
+    const auto writeStart = Clock::now();
+    out.write(reinterpret_cast<const char*>(result.data()), static_cast<streamsize>(result.size() * sizeof(double)));
+    stats.writeSeconds += chrono::duration<double>(Clock::now() - writeStart).count();
+    stats.bytesWritten += result.size() * sizeof(double);
+
+    lock_guard<mutex> lock(mtx);
+    ++written;
+    chunkWritten.notify_all();
+  }
+  for (auto& worker : workers)
+    worker.join();
+
+  // a failed write leaves the stream failed and makes every later write a no-op; the writer keeps going
+  // so the workers are not left waiting for their chunks to be written, and the failure is reported here
+  if (!out)
+    throw runtime_error("cannot write " + output);
+  out.close();
+  if (!out)
+    throw runtime_error("cannot close " + output);
+
+  stats.computeSeconds = computeNanos / 1e9;
+  stats.seconds = chrono::duration<double>(Clock::now() - start).count();
+  return stats;
+}
+
+// Reads back the roots written by solve_file and compares every one with QuadraticEquationSolver::solve
+// on the same coefficients
+template <typename Strategy>
+bool file_matches_solver(const string& output, const vector<double>& triples)
+{
+  const size_t count = triples.size() / 3;
+  vector<double> roots(4 * count);
+  ifstream in(output, ios::binary);
+  in.read(reinterpret_cast<char*>(roots.data()), static_cast<streamsize>(roots.size() * sizeof(double)));
+  if (!in || in.peek() != ifstream::traits_type::eof())
+    return false;
+
+  Strategy strategy;
+  QuadraticEquationSolver solver(strategy);
+  for (size_t i = 0; i < count; ++i) {
+    auto expected = solver.solve(triples[3 * i], triples[3 * i + 1], triples[3 * i + 2]);
+    const auto& x1 = get<0>(expected);
+    const auto& x2 = get<1>(expected);
+    if (!same_root(x1.real(), roots[4 * i]) || !same_root(x1.imag(), roots[4 * i + 1])
+      || !same_root(x2.real(), roots[4 * i + 2]) || !same_root(x2.imag(), roots[4 * i + 3]))
+      return false;
+  }
+  return true;
+}
+
+// Runs the file pipeline with one strategy, reports throughput and checks the output.
+// Workers busy most of the time means compute-bound; the writer busy most of the time means I/O-bound.
+template <typename Strategy>
+void run_file_pipeline(const char* name, const string& input, const string& output, const vector<double>& triples,
+  size_t threadCount)
+{
+  PipelineStats stats = solve_file<Strategy>(input, output, threadCount);
+  const bool identical = file_matches_solver<Strategy>(output, triples);
+  cout << name << ", " << threadCount << " threads: " << static_cast<size_t>(stats.equations / stats.seconds)
+    << " equations/sec, " << (stats.bytesRead + stats.bytesWritten) / stats.seconds / 1e9 << " GB/s in+out, workers busy "
+    << 100 * stats.computeSeconds / (stats.seconds * threadCount) << "%, writer busy "
+    << 100 * stats.writeSeconds / stats.seconds << "%" << (identical ? "" : " (MISMATCH)") << "\n";
+}
+
+// Writes `count` random equations to a scratch file and runs the file pipeline on it with both strategies
+void benchmark_file_pipeline(size_t count, size_t threadCount)
+{
+  const string input = "quadratic_coefficients.bin", output = "quadratic_roots.bin";
+  mt19937_64 rng(29);
+  uniform_real_distribution<double> coefficient(-100, 100);
+  vector<double> triples(3 * count);
+  for (size_t i = 0; i < count; ++i) {
+    triples[3 * i] = coefficient(rng);
+    triples[3 * i + 1] = coefficient(rng);
+    triples[3 * i + 2] = i % 16 == 0 ? triples[3 * i + 1] * triples[3 * i + 1] / (4 * triples[3 * i]) : coefficient(rng);
+  }
+  {
+    ofstream out(input, ios::binary);
+    out.write(reinterpret_cast<const char*>(triples.data()), static_cast<streamsize>(triples.size() * sizeof(double)));
+    if (!out)
+      throw runtime_error("cannot write " + input);
+  }
+
+  run_file_pipeline<OrdinaryDiscriminantStrategy>("ordinary", input, output, triples, threadCount);
+  run_file_pipeline<RealDiscriminantStrategy>("real    ", input, output, triples, threadCount);
+
+  remove(input.c_str());
+  remove(output.c_str());
+}
 
 int main()
 {
-    std::cout << "Hello World!\n";
+  benchmark_batch_solver<OrdinaryDiscriminantStrategy>("ordinary", 10000000);
+  benchmark_batch_solver<RealDiscriminantStrategy>("real    ", 10000000);
+
+  const size_t maxThreads = max(2u, thread::hardware_concurrency());
+  for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+    benchmark_file_pipeline(4000000, threads);
 }
\ No newline at end of file
@@ -17,6 +17,15 @@
 #include <complex>
 #include <tuple>
 #include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <string>
 using namespace std;
 
 struct Creature
@@ -60,6 +69,8 @@ struct CardGame
     other.health -= attacker.attack;
   }
 
+  // What the end of a combat does to a creature; damage persists unless a game hides this
+  static void recover(Creature&) {}
 
 };
 
@@ -70,9 +81,14 @@ struct TemporaryCardDamageGame : CardGame
   {
     OnCombatEnds = [this]()
     {
-      for (auto& creature : creatures) if (creature.health > 0) creature.health = creature.baseHealth;
+      for (auto& creature : creatures) recover(creature);
     };
   }
+
+  static void recover(Creature& creature)
+  {
+    if (creature.health > 0) creature.health = creature.baseHealth;
+  }
 };
 
 struct PermanentCardDamageGame : CardGame
@@ -81,7 +97,496 @@ struct PermanentCardDamageGame : CardGame
 
 };
 
+struct TournamentResult
+{
+  vector<int> wins, losses, draws;
+  vector<int> health; // after the last combat
+  int champion{ -1 }; // bracket only: the last creature standing, or -1
+
+  explicit TournamentResult(int n) : wins(n), losses(n), draws(n) {}
+
+  void tally(int creature1, int creature2, int winner)
+  {
+    if (winner == -1) {
+      ++draws[creature1];
+      ++draws[creature2];
+    }
+    else {
+      ++wins[winner];
+      ++losses[winner == creature1 ? creature2 : creature1];
+    }
+  }
+
+  bool operator==(const TournamentResult& other) const
+  {
+    return wins == other.wins && losses == other.losses && draws == other.draws && health == other.health && champion == other.champion;
+  }
+};
+
+// Barrier reused every round; the generation counter tells a woken thread its round really ended
+class RoundBarrier
+{
+  mutex mtx;
+  condition_variable cv;
+  size_t parties, waiting{ 0 }, generation{ 0 };
+
+public:
+  explicit RoundBarrier(size_t parties) : parties(parties) {}
+
+  void arrive_and_wait()
+  {
+    unique_lock<mutex> lock(mtx);
+    const size_t current = generation;
+    if (++waiting == parties) {
+      waiting = 0;
+      ++generation;
+      cv.notify_all();
+      return;
+    }
+    cv.wait(lock, [&] { return generation != current; });
+  }
+};
+
+// Circle-method schedule: n - 1 rounds (n when n is odd, one creature sitting out each round)
+struct RoundRobinSchedule
+{
+  static int rounds(int n) { return n < 2 ? 0 : (n % 2 == 0 ? n - 1 : n); }
+  static int slots(int n) { return (n + 1) / 2; }
+
+  // The pair meeting in `slot` of `round`; a pair containing n is a bye
+  static pair<int, int> pairing(int n, int round, int slot)
+  {
+    const int m = n + n % 2;
+    if (slot == 0)
+      return { round, m - 1 };
+    return { (round + slot) % (m - 1), (round + m - 1 - slot) % (m - 1) };
+  }
+};
+
+// Runs whole tournaments with the same outcome as calling Game::combat pair by pair in schedule order.
+// Combats are grouped into rounds in which no creature fights twice, so a round's combats commute and are
+// split across threads. A combat calls Game::hit and Game::recover through the static type, so the game's
+// own rules apply without a virtual call, and only the two combatants recover after it: every other living
+// creature has already recovered, which makes the game's full OnCombatEnds sweep a no-op for them.
+template <typename Game>
+class Tournament
+{
+  Game game;
+  size_t threadCount;
+
+  int fight(int creature1, int creature2)
+  {
+    Creature& c1 = game.creatures[creature1];
+    Creature& c2 = game.creatures[creature2];
+    game.Game::hit(c1, c2);
+    game.Game::hit(c2, c1);
+    Game::recover(c1);
+    Game::recover(c2);
+
+    if (c1.health > 0 && c2.health <= 0) return creature1;
+    if (c2.health > 0 && c1.health <= 0) return creature2;
+    return -1;
+  }
+
+  // The game's first OnCombatEnds reaches every living creature, including ones whose health was edited
+  // before the tournament; the first combat itself still starts from the current values
+  void reset_all_but(int creature1, int creature2)
+  {
+    for (int i = 0; i < size(); ++i)
+      if (i != creature1 && i != creature2)
+        Game::recover(game.creatures[i]);
+  }
+
+  int size() const { return static_cast<int>(game.creatures.size()); }
+
+  // prepare() runs on one thread between rounds and returns the number of combats in the next round
+  // (0 ends the tournament); play(slot) runs one combat of that round
+  template <typename Prepare, typename Play>
+  void run_rounds(Prepare prepare, Play play)
+  {
+    if (threadCount == 1) {
+      for (size_t count = prepare(); count != 0; count = prepare())
+        for (size_t slot = 0; slot < count; ++slot)
+          play(slot);
+      return;
+    }
+
+    RoundBarrier barrier(threadCount);
+    size_t count = prepare();
+    auto worker = [&](size_t t) {
+      while (count != 0) {
+        const size_t begin = count * t / threadCount, end = count * (t + 1) / threadCount;
+        for (size_t slot = begin; slot < end; ++slot)
+          play(slot);
+        barrier.arrive_and_wait();
+        if (t == 0)
+          count = prepare();
+        barrier.arrive_and_wait();
+      }
+    };
+
+    vector<thread> workers;
+    for (size_t t = 1; t < threadCount; ++t)
+      workers.emplace_back(worker, t);
+    worker(0);
+    for (auto& w : workers)
+      w.join();
+  }
+
+public:
+  Tournament(const vector<Creature>& creatures, size_t threadCount = thread::hardware_concurrency())
+    : game(creatures), threadCount(max<size_t>(1, threadCount)) {}
+
+  // Every creature fights every other creature once
+  TournamentResult round_robin()
+  {
+    const int n = size();
+    const int rounds = RoundRobinSchedule::rounds(n);
+    TournamentResult result(n);
+    int round = -1;
+
+    run_rounds(
+      [&]() -> size_t {
+        if (++round >= rounds)
+          return 0;
+        if (round == 0) {
+          auto first = RoundRobinSchedule::pairing(n, 0, 0);
+          if (first.second == n)
+            first = RoundRobinSchedule::pairing(n, 0, 1);
+          reset_all_but(first.first, first.second);
+        }
+        return RoundRobinSchedule::slots(n);
+      },
+      [&](size_t slot) {
+        const auto p = RoundRobinSchedule::pairing(n, round, static_cast<int>(slot));
+        if (p.first < n && p.second < n)
+          result.tally(p.first, p.second, fight(p.first, p.second));
+      });
+
+    result.health = healths();
+    return result;
+  }
+
+  // Single elimination in index order: neighbours fight, the winner advances, a draw eliminates both and an
+  // unpaired last entrant gets a bye
+  TournamentResult bracket()
+  {
+    const int n = size();
+    TournamentResult result(n);
+    vector<int> entrants(n), winners;
+    for (int i = 0; i < n; ++i)
+      entrants[i] = i;
+    bool first = true;
+
+    run_rounds(
+      [&]() -> size_t {
+        if (!first) {
+          vector<int> next;
+          for (int winner : winners)
+            if (winner != -1)
+              next.push_back(winner);
+          if (entrants.size() % 2 == 1)
+            next.push_back(entrants.back());
+          entrants.swap(next);
+        }
+        if (entrants.size() < 2)
+          return 0;
+        if (first)
+          reset_all_but(entrants[0], entrants[1]);
+        first = false;
+        winners.assign(entrants.size() / 2, -1);
+        return winners.size();
+      },
+      [&](size_t slot) {
+        const int creature1 = entrants[2 * slot], creature2 = entrants[2 * slot + 1];
+        winners[slot] = fight(creature1, creature2);
+        result.tally(creature1, creature2, winners[slot]);
+      });
+
+    result.champion = entrants.size() == 1 ? entrants[0] : -1;
+    result.health = healths();
+    return result;
+  }
+
+private:
+  vector<int> healths() const
+  {
+    vector<int> health;
+    for (auto& creature : game.creatures)
+      health.push_back(creature.health);
+    return health;
+  }
+};
+
+// Reference tournaments: the same schedules driven through CardGame::combat one pair at a time
+TournamentResult sequential_round_robin(CardGame& game)
+{
+  const int n = static_cast<int>(game.creatures.size());
+  TournamentResult result(n);
+  for (int round = 0; round < RoundRobinSchedule::rounds(n); ++round)
+    for (int slot = 0; slot < RoundRobinSchedule::slots(n); ++slot) {
+      const auto p = RoundRobinSchedule::pairing(n, round, slot);
+      if (p.first < n && p.second < n)
+        result.tally(p.first, p.second, game.combat(p.first, p.second));
+    }
+  for (auto& creature : game.creatures)
+    result.health.push_back(creature.health);
+  return result;
+}
+
+TournamentResult sequential_bracket(CardGame& game)
+{
+  const int n = static_cast<int>(game.creatures.size());
+  TournamentResult result(n);
+  vector<int> entrants(n);
+  for (int i = 0; i < n; ++i)
+    entrants[i] = i;
+  while (entrants.size() >= 2) {
+    vector<int> next;
+    for (size_t k = 0; k + 1 < entrants.size(); k += 2) {
+      const int winner = game.combat(entrants[k], entrants[k + 1]);
+      result.tally(entrants[k], entrants[k + 1], winner);
+      if (winner != -1)
+        next.push_back(winner);
+    }
+    if (entrants.size() % 2 == 1)
+      next.push_back(entrants.back());
+    entrants.swap(next);
+  }
+  result.champion = entrants.size() == 1 ? entrants[0] : -1;
+  for (auto& creature : game.creatures)
+    result.health.push_back(creature.health);
+  return result;
+}
+
+vector<Creature> random_creatures(int n, unsigned seed)
+{
+  mt19937 rng(seed);
+  uniform_int_distribution<int> attack(1, 6), health(1, 12);
+  vector<Creature> creatures;
+  for (int i = 0; i < n; ++i)
+    creatures.emplace_back(attack(rng), health(rng));
+  return creatures;
+}
+
+bool tournaments_match(int n, size_t threads)
+{
+  const auto creatures = random_creatures(n, n);
+  TemporaryCardDamageGame temporary(creatures), temporaryBracket(creatures);
+  PermanentCardDamageGame permanent(creatures), permanentBracket(creatures);
+  return Tournament<TemporaryCardDamageGame>(creatures, threads).round_robin() == sequential_round_robin(temporary)
+    && Tournament<PermanentCardDamageGame>(creatures, threads).round_robin() == sequential_round_robin(permanent)
+    && Tournament<TemporaryCardDamageGame>(creatures, threads).bracket() == sequential_bracket(temporaryBracket)
+    && Tournament<PermanentCardDamageGame>(creatures, threads).bracket() == sequential_bracket(permanentBracket);
+}
+
+template <typename F>
+double seconds(F f)
+{
+  const auto start = chrono::steady_clock::now();
+  f();
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void benchmark_round_robin(int n, size_t threads, bool withReference)
+{
+  const auto creatures = random_creatures(n, 7);
+  const double combats = n * (n - 1) / 2.0;
+  cout << n << " creatures, temporary damage, all pairs:";
+  if (withReference) {
+    TemporaryCardDamageGame game(creatures);
+    cout << " CardGame " << combats / seconds([&] { sequential_round_robin(game); }) << " combats/sec,";
+  }
+  Tournament<TemporaryCardDamageGame> single(creatures, 1), parallel(creatures, threads);
+  cout << " Tournament " << combats / seconds([&] { single.round_robin(); }) << " combats/sec, "
+    << threads << " threads " << combats / seconds([&] { parallel.round_robin(); }) << " combats/sec\n";
+}
+
+// Counter-based generator: the n-th number of a stream is a pure function of (key, n), so a match's draws
+// depend only on the seed and the match index, never on which thread plays it or what it played before
+class CounterRng
+{
+  uint64_t key, counter{ 0 };
+
+  static uint64_t mix(uint64_t x)
+  {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+public:
+  CounterRng(uint64_t seed, uint64_t stream) : key(mix(seed ^ mix(stream + 0x9e3779b97f4a7c15ull))) {}
+
+  uint64_t next() { return mix(key + ++counter * 0x9e3779b97f4a7c15ull); }
+
+  // uniform in [0, bound) by multiply-shift; the bias is negligible for deck-sized bounds
+  uint32_t below(uint32_t bound) { return static_cast<uint32_t>(((next() >> 32) * bound) >> 32); }
+};
+
+// A side's creatures waiting to fight, front first, in a fixed-capacity ring
+class Lineup
+{
+  vector<int> slots;
+  size_t head{ 0 }, count{ 0 };
+
+public:
+  explicit Lineup(size_t capacity) : slots(capacity) {}
+
+  void deal(int firstCreature, CounterRng& rng)
+  {
+    const size_t n = slots.size();
+    for (size_t i = 0; i < n; ++i)
+      slots[i] = firstCreature + static_cast<int>(i);
+    for (size_t i = n; i > 1; --i)
+      swap(slots[i - 1], slots[rng.below(static_cast<uint32_t>(i))]);
+    head = 0;
+    count = n;
+  }
+
+  bool empty() const { return count == 0; }
+  int front() const { return slots[head]; }
+  void pop() { head = (head + 1) % slots.size(); --count; }
+  void rotate() { slots[(head + count) % slots.size()] = slots[head]; pop(); ++count; }
+};
+
+struct MatchStats
+{
+  uint64_t matches{ 0 }, firstWins{ 0 }, secondWins{ 0 }, draws{ 0 }, combats{ 0 };
+
+  bool operator==(const MatchStats& other) const
+  {
+    return matches == other.matches && firstWins == other.firstWins && secondWins == other.secondWins
+      && draws == other.draws && combats == other.combats;
+  }
+};
+
+// One thread's game and lineups, built once and reused for every match the thread plays
+template <typename Game>
+struct MatchTable
+{
+  Game game;
+  int firstSize;
+  Lineup first, second;
+  size_t maxCombats;
+
+  MatchTable(const vector<Creature>& firstDeck, const vector<Creature>& secondDeck)
+    : game(concatenate(firstDeck, secondDeck)), firstSize(static_cast<int>(firstDeck.size())),
+      first(firstDeck.size()), second(secondDeck.size()), maxCombats(4 * (firstDeck.size() + secondDeck.size())) {}
+
+  static vector<Creature> concatenate(vector<Creature> a, const vector<Creature>& b)
+  {
+    a.insert(a.end(), b.begin(), b.end());
+    return a;
+  }
+
+  // Both decks are shuffled, then the front creatures fight through Game::combat. The dead leave, a
+  // survivor stays in front, and when both survive both go to the back. The side left with creatures wins;
+  // running out together, or a stalemate lasting maxCombats, is a draw.
+  void play(uint64_t seed, uint64_t match, MatchStats& stats)
+  {
+    CounterRng rng(seed, match);
+    for (auto& creature : game.creatures)
+      creature.health = creature.baseHealth;
+    first.deal(0, rng);
+    second.deal(firstSize, rng);
+
+    size_t combats = 0;
+    while (!first.empty() && !second.empty() && combats < maxCombats) {
+      const int creature1 = first.front(), creature2 = second.front();
+      game.combat(creature1, creature2);
+      ++combats;
+      const bool alive1 = game.creatures[creature1].health > 0, alive2 = game.creatures[creature2].health > 0;
+      if (alive1 && alive2) {
+        first.rotate();
+        second.rotate();
+      }
+      if (!alive1) first.pop();
+      if (!alive2) second.pop();
+    }
+
+    ++stats.matches;
+    stats.combats += combats;
+    if (first.empty() == second.empty()) ++stats.draws;
+    else if (second.empty()) ++stats.firstWins;
+    else ++stats.secondWins;
+  }
+};
+
+// Plays `matches` random matches of firstDeck against secondDeck under Game's damage rules. Threads claim
+// batches of match indices; each keeps its counts locally and adds them to the shared atomics once at the
+// end. Every match draws from its own (seed, index) stream and the totals are sums, so the result is the
+// same for any thread count.
+template <typename Game>
+MatchStats simulate_matches(const vector<Creature>& firstDeck, const vector<Creature>& secondDeck, uint64_t matches,
+  uint64_t seed, size_t threadCount = thread::hardware_concurrency())
+{
+  const uint64_t batch = 4096;
+  atomic<uint64_t> nextMatch{ 0 };
+  atomic<uint64_t> firstWins{ 0 }, secondWins{ 0 }, draws{ 0 }, combats{ 0 };
+
+  auto worker = [&] {
+    MatchTable<Game> table(firstDeck, secondDeck);
+    MatchStats local;
+    for (uint64_t begin = nextMatch.fetch_add(batch); begin < matches; begin = nextMatch.fetch_add(batch))
+      for (uint64_t match = begin; match < min(begin + batch, matches); ++match)
+        table.play(seed, match, local);
+    firstWins += local.firstWins;
+    secondWins += local.secondWins;
+    draws += local.draws;
+    combats += local.combats;
+  };
+
+  vector<thread> workers;
+  for (size_t t = 1; t < max<size_t>(1, threadCount); ++t)
+    workers.emplace_back(worker);
+  worker();
+  for (auto& w : workers)
+    w.join();
+
+  MatchStats stats;
+  stats.matches = matches;
+  stats.firstWins = firstWins;
+  stats.secondWins = secondWins;
+  stats.draws = draws;
+  stats.combats = combats;
+  return stats;
+}
+
+template <typename Game>
+void benchmark_matches(const string& name, const vector<Creature>& firstDeck, const vector<Creature>& secondDeck,
+  uint64_t matches, size_t threads)
+{
+  MatchStats stats;
+  const double elapsed = seconds([&] { stats = simulate_matches<Game>(firstDeck, secondDeck, matches, 2020, threads); });
+  cout << name << ", " << threads << " threads: first deck wins " << 100.0 * stats.firstWins / matches << "%, second "
+    << 100.0 * stats.secondWins / matches << "%, draws " << 100.0 * stats.draws / matches << "%, "
+    << matches / elapsed << " matches/sec\n";
+}
+
 int main()
 {
-    std::cout << "Hello World!\n";
+  TemporaryCardDamageGame temporary({ { 1, 2 }, { 1, 3 } });
+  PermanentCardDamageGame permanent({ { 1, 2 }, { 1, 3 } });
+  cout << "temporary 1/2 vs 1/3: " << temporary.combat(0, 1) << " " << temporary.combat(0, 1) << "\n";
+  cout << "permanent 1/2 vs 1/3: " << permanent.combat(0, 1) << " " << permanent.combat(0, 1) << "\n";
+
+  const size_t threads = max(4u, thread::hardware_concurrency());
+  cout << boolalpha;
+  for (int n : { 0, 1, 2, 3, 17, 64, 255 })
+    cout << n << " creatures, tournaments match CardGame::combat: " << (tournaments_match(n, 1) && tournaments_match(n, threads)) << "\n";
+
+  benchmark_round_robin(1000, threads, true);
+  benchmark_round_robin(8000, threads, false);
+
+  const vector<Creature> giants{ { 6, 5 }, { 5, 6 }, { 7, 3 }, { 3, 8 }, { 8, 2 } };
+  const vector<Creature> swarm{ { 3, 3 }, { 4, 2 }, { 2, 5 }, { 3, 4 }, { 5, 2 }, { 2, 3 }, { 4, 3 }, { 3, 2 } };
+  cout << "simulations reproducible across thread counts: "
+    << (simulate_matches<TemporaryCardDamageGame>(giants, swarm, 100000, 1, 1) == simulate_matches<TemporaryCardDamageGame>(giants, swarm, 100000, 1, threads)
+      && simulate_matches<PermanentCardDamageGame>(giants, swarm, 100000, 1, 1) == simulate_matches<PermanentCardDamageGame>(giants, swarm, 100000, 1, threads))
+    << "\n";
+  for (size_t t : { size_t(1), threads }) {
+    benchmark_matches<TemporaryCardDamageGame>("temporary damage", giants, swarm, 2000000, t);
+    benchmark_matches<PermanentCardDamageGame>("permanent damage", giants, swarm, 2000000, t);
+  }
 }
\ No newline at end of file
@@ -19,29 +19,261 @@
 #include <string>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <memory>
+#include <type_traits>
+#include <new>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include <stdexcept>
+#include <limits>
+#include <cstring>
 
 using namespace std;
 
+struct Value;
+struct AdditionExpression;
+struct MultiplicationExpression;
+
+// Double dispatch: an expression's accept() calls back the visit() overload for its own type
 struct ExpressionVisitor
 {
-  ostringstream result;
+  virtual void visit(Value& value) = 0;
+  virtual void visit(AdditionExpression& expr) = 0;
+  virtual void visit(MultiplicationExpression& expr) = 0;
+};
+
+struct Expression;
+
+// Prints into a plain char buffer that keeps its capacity between expressions; output is the same as
+// ExpressionPrinter's, without going through a stream
+struct BufferExpressionPrinter : ExpressionVisitor
+{
+  string buffer;
+
+  void append(char c) { buffer.push_back(c); }
+
+  void append(int value)
+  {
+    char digits[12];
+    char* end = digits + sizeof(digits);
+    char* begin = end;
+    unsigned magnitude = value < 0 ? 0u - static_cast<unsigned>(value) : static_cast<unsigned>(value);
+    do {
+      *--begin = static_cast<char>('0' + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0)
+      *--begin = '-';
+    buffer.append(begin, end);
+  }
+
+  void accept(Expression& expr);
+  void clear() { buffer.clear(); }
+
+  void visit(Value& value) override;
+  void visit(AdditionExpression& expr) override;
+  void visit(MultiplicationExpression& expr) override;
+
+  const string& str() const
+  {
+    return buffer;
+  }
 };
 
+// Expression values wrap around like 32-bit machine integers, so huge generated expressions stay defined
+inline int wrapping_add(int a, int b) { return static_cast<int>(static_cast<unsigned>(a) + static_cast<unsigned>(b)); }
+inline int wrapping_multiply(int a, int b) { return static_cast<int>(static_cast<unsigned>(a) * static_cast<unsigned>(b)); }
+
+// Evaluates an expression by recursive double dispatch
+struct ExpressionEvaluator : ExpressionVisitor
+{
+  int result{ 0 };
+  void accept(Expression& expr);
+
+  void visit(Value& value) override;
+  void visit(AdditionExpression& expr) override;
+  void visit(MultiplicationExpression& expr) override;
+};
+
+enum class PostfixOp : uint8_t { Leaf, Add, Multiply };
+
+struct PostfixInstruction
+{
+  PostfixOp op;
+  uint32_t leaf; // Leaf only: index into the leaf values
+};
+
+// An expression flattened into postfix order. Leaves are numbered left to right as they appear in the
+// tree, so the program can be rerun with other leaf values.
+struct PostfixProgram
+{
+  // Never exceeded: operands are ordered so that a program needs at most log2(leaves) + 1 slots
+  static const unsigned maxStack = 64;
+
+  vector<PostfixInstruction> code;
+  vector<int> leaves;
+  unsigned stackDepth{ 0 };
+};
+
+// Flattens an expression tree into a PostfixProgram. The first pass visits the tree and records it in preorder
+// with each subtree's stack need; the second emits postfix code, putting the needier operand of each
+// (commutative) operation first, as in Sethi-Ullman register allocation.
+class PostfixCompiler : ExpressionVisitor
+{
+  struct Flat
+  {
+    PostfixOp op;
+    uint8_t need;
+    uint32_t payload; // leaf index, or preorder index of the right operand
+  };
+  vector<Flat> flat;
+  PostfixProgram program;
+
+  void emit(uint32_t i)
+  {
+    const Flat& node = flat[i];
+    if (node.op == PostfixOp::Leaf) {
+      program.code.push_back({ PostfixOp::Leaf, node.payload });
+      return;
+    }
+    const uint32_t left = i + 1, right = node.payload;
+    if (flat[right].need > flat[left].need) {
+      emit(right);
+      emit(left);
+    }
+    else {
+      emit(left);
+      emit(right);
+    }
+    program.code.push_back({ node.op, 0 });
+  }
+
+  void binary(PostfixOp op, Expression& lhs, Expression& rhs);
+
+public:
+  void visit(Value& value) override;
+  void visit(AdditionExpression& expr) override;
+  void visit(MultiplicationExpression& expr) override;
+
+  static PostfixProgram compile(Expression& root);
+};
 
 struct Expression
 {
 public:
-  virtual void visit(ExpressionVisitor& ev) = 0;
+  virtual void accept(ExpressionVisitor& visitor) = 0;
 };
 
+inline void ExpressionEvaluator::accept(Expression& expr)
+{
+  expr.accept(*this);
+}
+
+inline void PostfixCompiler::binary(PostfixOp op, Expression& lhs, Expression& rhs)
+{
+  const size_t self = flat.size();
+  flat.push_back({ op, 0, 0 });
+  lhs.accept(*this);
+  const uint32_t right = static_cast<uint32_t>(flat.size());
+  rhs.accept(*this);
+  const uint8_t l = flat[self + 1].need, r = flat[right].need;
+  flat[self].need = static_cast<uint8_t>(l == r ? l + 1 : max(l, r));
+  flat[self].payload = right;
+}
+
+inline PostfixProgram PostfixCompiler::compile(Expression& root)
+{
+  PostfixCompiler compiler;
+  root.accept(compiler);
+  compiler.program.code.reserve(compiler.flat.size());
+  compiler.emit(0);
+  compiler.program.stackDepth = compiler.flat[0].need;
+  return move(compiler.program);
+}
+
+// Runs a program with the given leaf values (program.leaves by default) on a fixed stack
+inline int evaluate(const PostfixProgram& program, const int* leaves)
+{
+  int stack[PostfixProgram::maxStack];
+  int* top = stack;
+  for (const auto& instruction : program.code)
+    switch (instruction.op) {
+    case PostfixOp::Leaf:
+      *top++ = leaves[instruction.leaf];
+      break;
+    case PostfixOp::Add:
+      --top;
+      top[-1] = wrapping_add(top[-1], *top);
+      break;
+    case PostfixOp::Multiply:
+      --top;
+      top[-1] = wrapping_multiply(top[-1], *top);
+      break;
+    }
+  return stack[0];
+}
+
+inline int evaluate(const PostfixProgram& program)
+{
+  return evaluate(program, program.leaves.data());
+}
+
+// Many programs, each with its own leaves
+inline void evaluate_batch(const vector<PostfixProgram>& programs, int* results)
+{
+  for (size_t i = 0; i < programs.size(); ++i)
+    results[i] = evaluate(programs[i]);
+}
+
+// One program over `sets` leaf-value sets, stored one column per leaf: leaf k of set s is
+// leafColumns[k * sets + s]. Each instruction is applied to a block of sets at once, so every stack slot is
+// a short array and the inner loops vectorize.
+inline void evaluate_batch(const PostfixProgram& program, const int* leafColumns, size_t sets, int* results)
+{
+  const size_t lanes = 64;
+  int stack[PostfixProgram::maxStack][lanes];
+  for (size_t base = 0; base < sets; base += lanes) {
+    const size_t n = min(lanes, sets - base);
+    unsigned top = 0;
+    for (const auto& instruction : program.code) {
+      if (instruction.op == PostfixOp::Leaf) {
+        const int* column = leafColumns + instruction.leaf * sets + base;
+        for (size_t j = 0; j < n; ++j)
+          stack[top][j] = column[j];
+        ++top;
+        continue;
+      }
+      --top;
+      int* a = stack[top - 1];
+      const int* b = stack[top];
+      if (instruction.op == PostfixOp::Add)
+        for (size_t j = 0; j < n; ++j)
+          a[j] = wrapping_add(a[j], b[j]);
+      else
+        for (size_t j = 0; j < n; ++j)
+          a[j] = wrapping_multiply(a[j], b[j]);
+    }
+    copy(stack[0], stack[0] + n, results + base);
+  }
+}
+
+inline void BufferExpressionPrinter::accept(Expression& expr)
+{
+  expr.accept(*this);
+}
+
 struct Value : Expression
 {
 public:
   int value;
   Value(int value) : value(value) {}
-  void visit(ExpressionVisitor& epv)
+  void accept(ExpressionVisitor& visitor) override
   {
-    epv.result << value;
+    visitor.visit(*this);
   }
 };
 
@@ -50,13 +282,9 @@ struct AdditionExpression : Expression
   Expression& lhs, & rhs;
   AdditionExpression(Expression& lhs, Expression& rhs) : lhs(lhs), rhs(rhs) {}
 
-  void visit(ExpressionVisitor& epv)
+  void accept(ExpressionVisitor& visitor) override
   {
-    epv.result << "(";
-    lhs.visit(epv);
-    epv.result << "+";
-    rhs.visit(epv);
-    epv.result << ")";
+    visitor.visit(*this);
   }
 };
 
@@ -67,24 +295,98 @@ struct MultiplicationExpression : Expression
   MultiplicationExpression(Expression& lhs, Expression& rhs)
     : lhs(lhs), rhs(rhs) {}
 
-  void visit(ExpressionVisitor& epv)
+  void accept(ExpressionVisitor& visitor) override
   {
-    lhs.visit(epv);
-    epv.result << "*";
-    rhs.visit(epv);
+    visitor.visit(*this);
   }
 };
 
+inline void BufferExpressionPrinter::visit(Value& value)
+{
+  append(value.value);
+}
+
+inline void BufferExpressionPrinter::visit(AdditionExpression& expr)
+{
+  append('(');
+  expr.lhs.accept(*this);
+  append('+');
+  expr.rhs.accept(*this);
+  append(')');
+}
+
+inline void BufferExpressionPrinter::visit(MultiplicationExpression& expr)
+{
+  expr.lhs.accept(*this);
+  append('*');
+  expr.rhs.accept(*this);
+}
+
+inline void ExpressionEvaluator::visit(Value& value)
+{
+  result = value.value;
+}
+
+inline void ExpressionEvaluator::visit(AdditionExpression& expr)
+{
+  expr.lhs.accept(*this);
+  const int left = result;
+  expr.rhs.accept(*this);
+  result = wrapping_add(left, result);
+}
+
+inline void ExpressionEvaluator::visit(MultiplicationExpression& expr)
+{
+  expr.lhs.accept(*this);
+  const int left = result;
+  expr.rhs.accept(*this);
+  result = wrapping_multiply(left, result);
+}
+
+inline void PostfixCompiler::visit(Value& value)
+{
+  flat.push_back({ PostfixOp::Leaf, 1, static_cast<uint32_t>(program.leaves.size()) });
+  program.leaves.push_back(value.value);
+}
+
+inline void PostfixCompiler::visit(AdditionExpression& expr)
+{
+  binary(PostfixOp::Add, expr.lhs, expr.rhs);
+}
+
+inline void PostfixCompiler::visit(MultiplicationExpression& expr)
+{
+  binary(PostfixOp::Multiply, expr.lhs, expr.rhs);
+}
+
 struct ExpressionPrinter : ExpressionVisitor
 {
-  void accept(AdditionExpression& expr)
+  ostringstream result;
+
+  void accept(Expression& expr)
+  {
+    expr.accept(*this);
+  }
+
+  void visit(Value& value) override
+  {
+    result << value.value;
+  }
+
+  void visit(AdditionExpression& expr) override
   {
-    expr.visit(*this);
+    result << "(";
+    expr.lhs.accept(*this);
+    result << "+";
+    expr.rhs.accept(*this);
+    result << ")";
   }
 
-  void accept(MultiplicationExpression& expr)
+  void visit(MultiplicationExpression& expr) override
   {
-    expr.visit(*this);
+    expr.lhs.accept(*this);
+    result << "*";
+    expr.rhs.accept(*this);
   }
 
   string str() const
@@ -93,8 +395,460 @@ struct ExpressionPrinter : ExpressionVisitor
   }
 };
 
+// Bump allocator for expression nodes: one allocation per 64 KB block, everything released with the arena.
+// Nodes are trivially destructible, so nothing has to be run for them on release.
+class ExpressionArena
+{
+  static const size_t blockSize = 1 << 16;
+  vector<unique_ptr<char[]>> blocks;
+  size_t used{ blockSize };
+
+public:
+  template <typename T, typename... Args>
+  T& make(Args&&... args)
+  {
+    static_assert(is_trivially_destructible<T>::value, "arena nodes are never destroyed");
+    static_assert(sizeof(T) <= blockSize && alignof(T) <= alignof(max_align_t), "node does not fit a block");
+    size_t offset = (used + alignof(T) - 1) & ~(alignof(T) - 1);
+    if (offset + sizeof(T) > blockSize) {
+      blocks.emplace_back(new char[blockSize]);
+      offset = 0;
+    }
+    used = offset + sizeof(T);
+    return *new (blocks.back().get() + offset) T(forward<Args>(args)...);
+  }
+
+  size_t bytes_reserved() const { return blocks.size() * blockSize; }
+};
+
+// One heap allocation per node, as the exercise's separately owned nodes would be
+class HeapNodes
+{
+  vector<shared_ptr<void>> nodes;
+
+public:
+  template <typename T, typename... Args>
+  T& make(Args&&... args)
+  {
+    auto node = make_shared<T>(forward<Args>(args)...);
+    nodes.push_back(node);
+    return *node;
+  }
+};
 
-// Notice: I dont know what deep thought the author of this assignment had, but changing the accept and visit methods is a stupid solution
+// Random expression with `leaves` values (at least 2), combined level by level into a balanced tree, so
+// printing recursion stays O(log n) deep
+template <typename Nodes>
+Expression& random_expression(Nodes& nodes, size_t leaves, unsigned seed)
+{
+  mt19937 rng(seed);
+  uniform_int_distribution<int> value(-999, 999);
+  bernoulli_distribution addition(0.5);
+  vector<Expression*> level;
+  for (size_t i = 0; i < leaves; ++i)
+    level.push_back(&nodes.template make<Value>(value(rng)));
+  while (level.size() > 1) {
+    vector<Expression*> next;
+    for (size_t i = 0; i + 1 < level.size(); i += 2)
+      if (addition(rng))
+        next.push_back(&nodes.template make<AdditionExpression>(*level[i], *level[i + 1]));
+      else
+        next.push_back(&nodes.template make<MultiplicationExpression>(*level[i], *level[i + 1]));
+    if (level.size() % 2 == 1)
+      next.push_back(level.back());
+    level.swap(next);
+  }
+  return *level[0];
+}
+
+template <typename F>
+double seconds(F f)
+{
+  const auto start = chrono::steady_clock::now();
+  f();
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void benchmark_printing(size_t leaves)
+{
+  HeapNodes heap;
+  ExpressionArena arena;
+  Expression* heapRoot = nullptr;
+  Expression* arenaRoot = nullptr;
+  const double heapBuild = seconds([&] { heapRoot = &random_expression(heap, leaves, 45); });
+  const double arenaBuild = seconds([&] { arenaRoot = &random_expression(arena, leaves, 45); });
+
+  string streamed;
+  const double streamPrint = seconds([&] {
+    ExpressionPrinter ep;
+    ep.accept(*heapRoot);
+    streamed = ep.str();
+  });
+  BufferExpressionPrinter bp;
+  bp.buffer.reserve(streamed.size());
+  const double bufferPrint = seconds([&] { bp.accept(*arenaRoot); });
+
+  cout << 2 * leaves - 1 << " nodes: build heap " << heapBuild << "s, arena " << arenaBuild << "s; print ostringstream "
+    << streamPrint << "s, buffer " << bufferPrint << "s (" << streamed.size() / bufferPrint / 1e6 << " MB/s); identical: "
+    << (bp.str() == streamed) << "\n";
+}
+
+// Collects the Value nodes of an expression in left-to-right order, i.e. in PostfixProgram leaf order
+struct LeafCollector : ExpressionVisitor
+{
+  vector<Value*> leaves;
+
+  void accept(Expression& expr)
+  {
+    expr.accept(*this);
+  }
+
+  void visit(Value& value) override
+  {
+    leaves.push_back(&value);
+  }
+
+  void visit(AdditionExpression& expr) override
+  {
+    expr.lhs.accept(*this);
+    expr.rhs.accept(*this);
+  }
+
+  void visit(MultiplicationExpression& expr) override
+  {
+    expr.lhs.accept(*this);
+    expr.rhs.accept(*this);
+  }
+};
+
+// Right-leaning chain v0 + (v1 * (v2 + ...)), the worst case for a naive postfix stack
+Expression& right_chain(ExpressionArena& arena, int length)
+{
+  Expression* expr = &arena.make<Value>(length);
+  for (int i = length - 1; i >= 0; --i)
+    if (i % 2 == 0)
+      expr = &arena.make<AdditionExpression>(arena.make<Value>(i), *expr);
+    else
+      expr = &arena.make<MultiplicationExpression>(arena.make<Value>(i), *expr);
+  return *expr;
+}
+
+void benchmark_evaluation(size_t leaves, size_t smallLeaves, size_t sets)
+{
+  ExpressionArena arena;
+  Expression& big = random_expression(arena, leaves, 46);
+  ExpressionEvaluator evaluator;
+  PostfixProgram program;
+  int postfixResult = 0;
+  const double recursive = seconds([&] { evaluator.accept(big); });
+  const double compile = seconds([&] { program = PostfixCompiler::compile(big); });
+  const double postfix = seconds([&] { postfixResult = evaluate(program); });
+  cout << 2 * leaves - 1 << " nodes: recursive visitor " << recursive << "s, compile " << compile << "s, postfix "
+    << postfix << "s, stack depth " << program.stackDepth << ", same value: " << (postfixResult == evaluator.result) << "\n";
+
+  Expression& small = random_expression(arena, smallLeaves, 47);
+  const PostfixProgram smallProgram = PostfixCompiler::compile(small);
+  LeafCollector collector;
+  collector.accept(small);
+  const vector<Value*>& values = collector.leaves;
+  mt19937 rng(48);
+  uniform_int_distribution<int> value(-9, 9);
+  vector<int> columns(smallLeaves * sets);
+  for (auto& v : columns)
+    v = value(rng);
+
+  vector<int> expected(sets), actual(sets);
+  const double perSet = seconds([&] {
+    for (size_t s = 0; s < sets; ++s) {
+      for (size_t k = 0; k < smallLeaves; ++k)
+        values[k]->value = columns[k * sets + s];
+      evaluator.accept(small);
+      expected[s] = evaluator.result;
+    }
+  });
+  const double batch = seconds([&] { evaluate_batch(smallProgram, columns.data(), sets, actual.data()); });
+  cout << sets << " leaf sets of a " << 2 * smallLeaves - 1 << "-node expression: recursive visitor "
+    << sets / perSet << " evaluations/sec, postfix batch " << sets / batch << " evaluations/sec, same values: "
+    << (expected == actual) << "\n";
+}
+
+// Hash-consing builder: structurally identical nodes are created once, so repeated subexpressions become
+// shared nodes of a DAG. Nodes are the ordinary expression types (every visitor still works on them) and
+// are also recorded in creation order, children before parents, for the memoizing visitors below.
+class ExpressionDag
+{
+public:
+  struct Node
+  {
+    PostfixOp op;
+    int value;             // Leaf only
+    uint32_t left, right;  // operand ids, Add and Multiply only
+    Expression* expr;
+  };
+
+private:
+  struct Key
+  {
+    PostfixOp op;
+    int value;
+    uint32_t left, right;
+    bool operator==(const Key& other) const
+    {
+      return op == other.op && value == other.value && left == other.left && right == other.right;
+    }
+  };
+
+  struct KeyHash
+  {
+    size_t operator()(const Key& key) const
+    {
+      uint64_t h = static_cast<uint64_t>(key.op) * 0x9e3779b97f4a7c15ull ^ static_cast<uint32_t>(key.value);
+      h = (h ^ (h >> 29)) * 0xbf58476d1ce4e5b9ull ^ key.left;
+      h = (h ^ (h >> 31)) * 0x94d049bb133111ebull ^ key.right;
+      return static_cast<size_t>(h ^ (h >> 32));
+    }
+  };
+
+  // Visits a source expression bottom-up, remembering the node id each source node was interned as
+  class Importer : ExpressionVisitor
+  {
+    ExpressionDag& dag;
+    unordered_map<const Expression*, uint32_t> imported;
+    uint32_t result{ 0 };
+
+    void visit(Value& value) override
+    {
+      result = dag.id_of(dag.value(value.value));
+    }
+
+    void visit(AdditionExpression& expr) override
+    {
+      const uint32_t lhs = import(expr.lhs), rhs = import(expr.rhs);
+      result = dag.id_of(dag.add(*dag.table[lhs].expr, *dag.table[rhs].expr));
+    }
+
+    void visit(MultiplicationExpression& expr) override
+    {
+      const uint32_t lhs = import(expr.lhs), rhs = import(expr.rhs);
+      result = dag.id_of(dag.multiply(*dag.table[lhs].expr, *dag.table[rhs].expr));
+    }
+
+  public:
+    explicit Importer(ExpressionDag& dag) : dag(dag) {}
+
+    uint32_t import(Expression& expr)
+    {
+      auto found = imported.find(&expr);
+      if (found != imported.end())
+        return found->second;
+      expr.accept(*this);
+      imported.emplace(&expr, result);
+      return result;
+    }
+  };
+
+  ExpressionArena arena;
+  vector<Node> table;
+  unordered_map<Key, uint32_t, KeyHash> interned;
+  unordered_map<const Expression*, uint32_t> ids;
+
+  template <typename T, typename... Args>
+  T& intern(const Key& key, Args&... args)
+  {
+    auto found = interned.find(key);
+    if (found != interned.end())
+      return static_cast<T&>(*table[found->second].expr);
+    T& node = arena.make<T>(args...);
+    const uint32_t id = static_cast<uint32_t>(table.size());
+    table.push_back({ key.op, key.value, key.left, key.right, &node });
+    interned.emplace(key, id);
+    ids.emplace(&node, id);
+    return node;
+  }
+
+public:
+  Value& value(int v)
+  {
+    return intern<Value>({ PostfixOp::Leaf, v, 0, 0 }, v);
+  }
+
+  // Operands must be nodes of this DAG
+  AdditionExpression& add(Expression& lhs, Expression& rhs)
+  {
+    return intern<AdditionExpression>({ PostfixOp::Add, 0, id_of(lhs), id_of(rhs) }, lhs, rhs);
+  }
+
+  MultiplicationExpression& multiply(Expression& lhs, Expression& rhs)
+  {
+    return intern<MultiplicationExpression>({ PostfixOp::Multiply, 0, id_of(lhs), id_of(rhs) }, lhs, rhs);
+  }
+
+  // Same interface as ExpressionArena, so generators can build either a tree or a DAG
+  template <typename T, typename... Args>
+  T& make(Args&&... args) { return make(static_cast<T*>(nullptr), args...); }
+  Value& make(Value*, int v) { return value(v); }
+  AdditionExpression& make(AdditionExpression*, Expression& lhs, Expression& rhs) { return add(lhs, rhs); }
+  MultiplicationExpression& make(MultiplicationExpression*, Expression& lhs, Expression& rhs) { return multiply(lhs, rhs); }
+
+  // Interns an existing tree (or DAG) built elsewhere and returns its node in this DAG. Each source node
+  // is interned once, so a shared subexpression is not walked again wherever else it appears.
+  Expression& import(Expression& expr)
+  {
+    Importer importer(*this);
+    return *table[importer.import(expr)].expr;
+  }
+
+  uint32_t id_of(const Expression& expr) const { return ids.at(&expr); }
+  const Node& node(uint32_t id) const { return table[id]; }
+  size_t size() const { return table.size(); }
+};
+
+// Evaluates DAG nodes once each. Values are kept between calls, and a call only computes nodes added to
+// the DAG since the last one.
+class MemoizingEvaluator
+{
+  const ExpressionDag& dag;
+  vector<int> values;
+
+public:
+  explicit MemoizingEvaluator(const ExpressionDag& dag) : dag(dag) {}
+
+  int evaluate(const Expression& expr)
+  {
+    for (uint32_t id = static_cast<uint32_t>(values.size()); id < dag.size(); ++id) {
+      const auto& node = dag.node(id);
+      values.push_back(node.op == PostfixOp::Leaf ? node.value
+        : node.op == PostfixOp::Add ? wrapping_add(values[node.left], values[node.right])
+        : wrapping_multiply(values[node.left], values[node.right]));
+    }
+    return values[dag.id_of(expr)];
+  }
+};
+
+// Prints DAG nodes with the same output as ExpressionPrinter. Each node's text is produced once per print;
+// later occurrences copy it from where it first appeared in the output buffer. Printed lengths are
+// memoized per node (saturating), so the size of a print is known without printing.
+class MemoizingPrinter
+{
+  const ExpressionDag& dag;
+  vector<uint64_t> lengths;
+  vector<size_t> firstAt;
+  vector<uint32_t> printedIn;
+  uint32_t print{ 0 };
+  BufferExpressionPrinter out;
+
+  void emit(uint32_t id)
+  {
+    if (printedIn[id] == print) {
+      const size_t from = firstAt[id], length = static_cast<size_t>(lengths[id]), at = out.buffer.size();
+      out.buffer.resize(at + length);
+      memcpy(&out.buffer[at], &out.buffer[from], length);
+      return;
+    }
+    const size_t start = out.buffer.size();
+    const auto& node = dag.node(id);
+    if (node.op == PostfixOp::Leaf)
+      out.append(node.value);
+    else if (node.op == PostfixOp::Add) {
+      out.append('(');
+      emit(node.left);
+      out.append('+');
+      emit(node.right);
+      out.append(')');
+    }
+    else {
+      emit(node.left);
+      out.append('*');
+      emit(node.right);
+    }
+    printedIn[id] = print;
+    firstAt[id] = start;
+  }
+
+public:
+  explicit MemoizingPrinter(const ExpressionDag& dag) : dag(dag) {}
+
+  uint64_t printed_length(const Expression& expr)
+  {
+    const uint64_t saturated = numeric_limits<uint64_t>::max();
+    auto sum = [&](uint64_t a, uint64_t b) { return a > saturated - b ? saturated : a + b; };
+    for (uint32_t id = static_cast<uint32_t>(lengths.size()); id < dag.size(); ++id) {
+      const auto& node = dag.node(id);
+      if (node.op == PostfixOp::Leaf) {
+        BufferExpressionPrinter digits;
+        digits.append(node.value);
+        lengths.push_back(digits.buffer.size());
+      }
+      else
+        lengths.push_back(sum(sum(lengths[node.left], lengths[node.right]), node.op == PostfixOp::Add ? 3 : 1));
+    }
+    return lengths[dag.id_of(expr)];
+  }
+
+  void accept(const Expression& expr)
+  {
+    const uint64_t length = printed_length(expr);
+    if (length > out.buffer.max_size() - out.buffer.size())
+      throw length_error("expression too long to print");
+    out.buffer.reserve(out.buffer.size() + static_cast<size_t>(length));
+    firstAt.resize(dag.size());
+    printedIn.resize(dag.size(), 0);
+    ++print;
+    emit(dag.id_of(expr));
+  }
+
+  void clear() { out.clear(); }
+
+  const string& str() const
+  {
+    return out.str();
+  }
+};
+
+// Machine-generated style input: subexpression `index` of `level` is a fixed function of both, so the same
+// few subtrees recur all over the full 2^levels-leaf tree
+template <typename Nodes>
+Expression& generated_expression(Nodes& nodes, int level, unsigned index, unsigned width)
+{
+  unsigned h = (static_cast<unsigned>(level) * 0x9e3779b1u) ^ (index * 0x85ebca6bu);
+  h ^= h >> 15;
+  h *= 0x2c1b3c6du;
+  h ^= h >> 12;
+  if (level == 0)
+    return nodes.template make<Value>(static_cast<int>(h % 19) - 9);
+  Expression& lhs = generated_expression(nodes, level - 1, h % width, width);
+  Expression& rhs = generated_expression(nodes, level - 1, (h >> 8) % width, width);
+  if (h & (1u << 20))
+    return nodes.template make<AdditionExpression>(lhs, rhs);
+  return nodes.template make<MultiplicationExpression>(lhs, rhs);
+}
+
+void benchmark_dag(int levels, unsigned width)
+{
+  ExpressionArena arena;
+  ExpressionDag dag;
+  Expression* tree = nullptr;
+  Expression* shared = nullptr;
+  const double treeBuild = seconds([&] { tree = &generated_expression(arena, levels, 0, width); });
+  const double dagBuild = seconds([&] { shared = &generated_expression(dag, levels, 0, width); });
+
+  BufferExpressionPrinter bp;
+  ExpressionEvaluator evaluator;
+  const double treePrint = seconds([&] { bp.accept(*tree); });
+  const double treeEvaluate = seconds([&] { evaluator.accept(*tree); });
+
+  MemoizingPrinter mp(dag);
+  MemoizingEvaluator me(dag);
+  int value = 0;
+  const double dagPrint = seconds([&] { mp.accept(*shared); });
+  const double dagEvaluate = seconds([&] { value = me.evaluate(*shared); });
+
+  cout << (2u << levels) - 1 << "-node generated tree, " << dag.size() << " unique nodes: build tree " << treeBuild
+    << "s, DAG " << dagBuild << "s; print tree " << treePrint << "s, DAG " << dagPrint << "s; evaluate tree "
+    << treeEvaluate << "s, DAG " << dagEvaluate << "s; same text: " << (mp.str() == bp.str())
+    << ", same value: " << (value == evaluator.result) << ", import finds the same root: "
+    << (&dag.import(*tree) == shared) << "\n";
+}
 
 int main() {
   Value v2{ 2 };
@@ -103,6 +857,73 @@ int main() {
   ExpressionPrinter ep;
   ep.accept(simple);
   //assert(ep.str() == "(2+3)");
+
+  BufferExpressionPrinter bp;
+  bp.accept(simple);
+  cout << boolalpha << bp.str() << " matches ExpressionPrinter: " << (bp.str() == ep.str()) << "\n";
+
+  ExpressionArena arena;
+  Value& lowest = arena.make<Value>(-2147483647 - 1);
+  Value& negative = arena.make<Value>(-40);
+  MultiplicationExpression& product = arena.make<MultiplicationExpression>(lowest, negative);
+  AdditionExpression& sum = arena.make<AdditionExpression>(product, arena.make<Value>(0));
+  ExpressionPrinter streamed;
+  streamed.accept(sum);
+  bp.clear();
+  bp.accept(sum);
+  cout << bp.str() << " matches ExpressionPrinter: " << (bp.str() == streamed.str()) << "\n";
+
+  benchmark_printing(1000000);
+
+  const PostfixProgram simpleProgram = PostfixCompiler::compile(simple);
+  ExpressionEvaluator evaluator;
+  evaluator.accept(sum);
+  cout << "(2+3) = " << evaluate(simpleProgram) << ", postfix matches visitor on " << bp.str() << ": "
+    << (evaluate(PostfixCompiler::compile(sum)) == evaluator.result) << "\n";
+
+  Expression& chain = right_chain(arena, 10000);
+  const PostfixProgram chainProgram = PostfixCompiler::compile(chain);
+  evaluator.accept(chain);
+  cout << "10001-leaf right chain: stack depth " << chainProgram.stackDepth << ", postfix matches visitor: "
+    << (evaluate(chainProgram) == evaluator.result) << "\n";
+
+  vector<PostfixProgram> programs;
+  vector<int> expected;
+  for (unsigned seed = 0; seed < 1000; ++seed) {
+    Expression& expr = random_expression(arena, 2 + seed % 50, seed);
+    programs.push_back(PostfixCompiler::compile(expr));
+    evaluator.accept(expr);
+    expected.push_back(evaluator.result);
+  }
+  vector<int> results(programs.size());
+  evaluate_batch(programs, results.data());
+  cout << "1000 programs evaluated in a batch match the visitor: " << (results == expected) << "\n";
+
+  benchmark_evaluation(1000000, 64, 1000000);
+
+  ExpressionDag dag;
+  Expression& two = dag.add(dag.value(1), dag.value(1));
+  Expression& doubled = dag.multiply(two, dag.add(dag.value(1), dag.value(1)));
+  MemoizingPrinter mp(dag);
+  mp.accept(doubled);
+  ExpressionPrinter expanded;
+  expanded.accept(static_cast<MultiplicationExpression&>(doubled));
+  cout << mp.str() << " has " << dag.size() << " unique nodes, shared operand: " << (&two == &dag.add(dag.value(1), dag.value(1)))
+    << ", matches ExpressionPrinter: " << (mp.str() == expanded.str()) << "\n";
+
+  Expression* power = &dag.value(3);
+  for (int i = 0; i < 100; ++i)
+    power = &dag.multiply(*power, *power);
+  MemoizingEvaluator me(dag);
+  cout << "3^(2^100) mod 2^32 = " << static_cast<unsigned>(me.evaluate(*power)) << " from " << dag.size()
+    << " nodes; printing it would take " << mp.printed_length(*power) << " chars (saturated)\n";
+
+  ExpressionDag copy;
+  Expression& imported = copy.import(*power);
+  MemoizingEvaluator copyEvaluator(copy);
+  cout << "importing it into a new DAG makes " << copy.size() << " nodes, same value: "
+    << (copyEvaluator.evaluate(imported) == me.evaluate(*power)) << "\n";
+
+  benchmark_dag(21, 8);
   return 0;
 }
-
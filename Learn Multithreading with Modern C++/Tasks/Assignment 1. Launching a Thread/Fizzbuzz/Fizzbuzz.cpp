@@ -1,5 +1,21 @@
 #include <iostream>
 #include <thread>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 void LaunchFizzBuzzGame(size_t numberOfChildren)
 {
@@ -19,9 +35,247 @@ void LaunchFizzBuzzGame(size_t numberOfChildren)
   }
 }
 
+// Decimal digits of a number kept as text, followed by a newline, and incremented in place, so consecutive
+// numbers are never converted from binary. Unused leading positions hold '0', which lets a carry grow the
+// number by a digit.
+class DecimalCounter
+{
+  static const size_t capacity = 24;
+  char digits[2 * capacity]; // the second half lets Line() be copied at a fixed width
+  size_t first;
+
+public:
+  static const size_t copyWidth = capacity;
+
+  explicit DecimalCounter(uint64_t value) : first(capacity - 1)
+  {
+    std::memset(digits, '0', sizeof(digits));
+    digits[capacity - 1] = '\n';
+    do {
+      digits[--first] = static_cast<char>('0' + value % 10);
+      value /= 10;
+    } while (value != 0);
+  }
+
+  void Increment()
+  {
+    size_t i = capacity - 2;
+    while (digits[i] == '9')
+      digits[i--] = '0';
+    ++digits[i];
+    if (i < first)
+      first = i;
+  }
+
+  // The number and its newline; copyWidth bytes may be read from here
+  const char* Line() const { return digits + first; }
+  size_t LineSize() const { return capacity - first; }
+};
+
+// Formats the lines for numbers [first, last] into out and returns the end of the text. Numbers are copied
+// at a fixed width, so out needs DecimalCounter::copyWidth bytes of room past the end of the text.
+char* FormatFizzBuzz(uint64_t first, uint64_t last, char* out)
+{
+  DecimalCounter number(first);
+  unsigned phase = static_cast<unsigned>(first % 15);
+  for (uint64_t i = first; i <= last; ++i) {
+    switch (phase) {
+    case 0:
+      std::memcpy(out, "FizzBuzz\n", 9);
+      out += 9;
+      break;
+    case 3: case 6: case 9: case 12:
+      std::memcpy(out, "Fizz\n", 5);
+      out += 5;
+      break;
+    case 5: case 10:
+      std::memcpy(out, "Buzz\n", 5);
+      out += 5;
+      break;
+    default:
+      std::memcpy(out, number.Line(), DecimalCounter::copyWidth);
+      out += number.LineSize();
+    }
+    number.Increment();
+    phase = phase == 14 ? 0 : phase + 1;
+  }
+  return out;
+}
+
+struct FizzBuzzStats
+{
+  uint64_t bytes{ 0 };
+  double seconds{ 0 };
+};
 
-int main()
+// Produces the same text as LaunchFizzBuzzGame(count) and hands it to sink in order, in chunks of
+// numbersPerChunk numbers. Worker w formats chunks w, w + threads, ... into its own two buffers, so it can
+// fill one while the other waits to be written; the calling thread passes finished chunks to sink in
+// order and frees their buffer. Nothing is allocated after start-up. If sink throws, the workers are
+// stopped and joined before the exception is rethrown.
+FizzBuzzStats GenerateFizzBuzz(uint64_t count, size_t threads, const std::function<void(const char*, size_t)>& sink,
+  uint64_t numbersPerChunk = 15 * 16384)
 {
+  const auto start = std::chrono::steady_clock::now();
+  threads = threads == 0 ? 1 : threads;
+  const uint64_t chunks = (count + numbersPerChunk - 1) / numbersPerChunk;
+  const size_t maxLine = std::max<size_t>(DecimalCounter(count).LineSize(), sizeof("FizzBuzz\n") - 1);
+
+  struct Slot
+  {
+    std::vector<char> buffer;
+    size_t size{ 0 };
+    uint64_t chunk{ 0 };
+    bool full{ false };
+  };
+  std::vector<Slot> slots(2 * threads);
+  for (auto& slot : slots)
+    slot.buffer.resize(static_cast<size_t>(numbersPerChunk * maxLine) + DecimalCounter::copyWidth);
+
+  std::mutex mtx;
+  std::condition_variable slotFull, slotFree;
+  bool stopping = false; // set when sink fails; workers stop instead of waiting for a slot
+
+  auto worker = [&](size_t w) {
+    for (uint64_t chunk = w; chunk < chunks; chunk += threads) {
+      Slot& slot = slots[2 * w + (chunk / threads) % 2];
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        slotFree.wait(lock, [&] { return !slot.full || stopping; });
+        if (stopping)
+          return;
+      }
+      const uint64_t first = chunk * numbersPerChunk + 1;
+      const uint64_t last = std::min(count, first + numbersPerChunk - 1);
+      char* end = FormatFizzBuzz(first, last, slot.buffer.data());
+
+      std::lock_guard<std::mutex> lock(mtx);
+      slot.size = static_cast<size_t>(end - slot.buffer.data());
+      slot.chunk = chunk;
+      slot.full = true;
+      slotFull.notify_all();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t w = 0; w < threads; ++w)
+    workers.emplace_back(worker, w);
+
+  FizzBuzzStats stats;
+  try {
+    for (uint64_t chunk = 0; chunk < chunks; ++chunk) {
+      Slot& slot = slots[2 * (chunk % threads) + (chunk / threads) % 2];
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        slotFull.wait(lock, [&] { return slot.full && slot.chunk == chunk; });
+      }
+      sink(slot.buffer.data(), slot.size);
+      stats.bytes += slot.size;
+
+      std::lock_guard<std::mutex> lock(mtx);
+      slot.full = false;
+      slotFree.notify_all();
+    }
+  }
+  catch (...) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      stopping = true;
+    }
+    slotFree.notify_all();
+    for (auto& w : workers)
+      w.join();
+    throw;
+  }
+  for (auto& w : workers)
+    w.join();
+
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return stats;
+}
+
+// One large write per chunk straight to the standard output descriptor, bypassing iostream buffering
+void WriteToStdout(const char* data, size_t size)
+{
+  while (size != 0) {
+#ifdef _WIN32
+    const int written = _write(1, data, static_cast<unsigned>(std::min<size_t>(size, 1u << 30)));
+#else
+    const ssize_t written = write(1, data, size);
+#endif
+    if (written <= 0)
+      throw std::runtime_error("write to standard output failed");
+    data += written;
+    size -= static_cast<size_t>(written);
+  }
+}
+
+// LaunchFizzBuzzGame's output for count, captured from std::cout
+std::string SerialFizzBuzz(size_t count)
+{
+  std::ostringstream captured;
+  std::streambuf* original = std::cout.rdbuf(captured.rdbuf());
+  LaunchFizzBuzzGame(count);
+  std::cout.rdbuf(original);
+  return captured.str();
+}
+
+bool EngineMatchesSerial(uint64_t count, size_t threads, uint64_t numbersPerChunk)
+{
+  std::string generated;
+  GenerateFizzBuzz(count, threads, [&](const char* data, size_t size) { generated.append(data, size); }, numbersPerChunk);
+  return generated == SerialFizzBuzz(static_cast<size_t>(count));
+}
+
+// A sink that fails part-way must come back out of GenerateFizzBuzz as the same exception
+bool EngineStopsOnSinkFailure(size_t threads)
+{
+  size_t calls = 0;
+  try {
+    GenerateFizzBuzz(100000, threads, [&](const char*, size_t) {
+      if (++calls == 5)
+        throw std::runtime_error("sink failed");
+    }, 15);
+  }
+  catch (const std::runtime_error&) {
+    return calls == 5;
+  }
+  return false;
+}
+
+// Fizzbuzz                    - the original interactive game
+// Fizzbuzz <count> [threads]  - the engine writing to standard output, throughput on standard error
+// Fizzbuzz --verify           - compares the engine with LaunchFizzBuzzGame
+int main(int argc, char* argv[])
+{
+  if (argc > 1 && std::string(argv[1]) == "--verify") {
+    bool matches = EngineMatchesSerial(1000000, 4, 15 * 16384);
+    for (uint64_t count : { 0, 1, 14, 15, 16, 99, 100, 1000, 99999 })
+      for (size_t threads : { 1, 2, 3, 8 })
+        for (uint64_t numbersPerChunk : { 1, 7, 15, 1000 })
+          matches = matches && EngineMatchesSerial(count, threads, numbersPerChunk);
+    std::cout << "engine matches LaunchFizzBuzzGame: " << std::boolalpha << matches << std::endl;
+    const bool stops = EngineStopsOnSinkFailure(1) && EngineStopsOnSinkFailure(4);
+    std::cout << "engine stops on sink failure: " << stops << std::endl;
+    return matches && stops ? 0 : 1;
+  }
+
+  if (argc > 1) {
+    const uint64_t count = std::stoull(argv[1]);
+    const size_t threads = argc > 2 ? std::stoul(argv[2]) : std::thread::hardware_concurrency();
+    FizzBuzzStats stats;
+    try {
+      stats = GenerateFizzBuzz(count, threads, WriteToStdout);
+    }
+    catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    std::cerr << stats.bytes << " bytes in " << stats.seconds << "s: " << stats.bytes / stats.seconds / 1e9 << " GB/s, "
+      << count / stats.seconds << " lines/sec" << std::endl;
+    return 0;
+  }
+
   size_t numberOfChildren{ 0 };
   std::cout << "Enter the number of children: ";
   std::cin >> numberOfChildren;
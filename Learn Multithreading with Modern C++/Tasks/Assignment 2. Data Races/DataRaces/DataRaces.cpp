@@ -1,6 +1,11 @@
 #include <iostream>
 #include <vector>
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <type_traits>
 
 int global = 0;
 
@@ -9,6 +14,134 @@ void IncrementGlobalVariable()
   for (; global < 10000; ++global){}
 }
 
+// Counter strategies. Each offers Increment(thread), where thread is the caller's index below the thread
+// count the counter was made for, and Read(), which may run concurrently with increments.
+
+// Every increment takes the same lock
+class MutexCounter
+{
+  std::mutex mtx;
+  long long value{ 0 };
+
+public:
+  explicit MutexCounter(size_t) {}
+
+  void Increment(size_t)
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    ++value;
+  }
+
+  long long Read()
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    return value;
+  }
+};
+
+// Every increment is an atomic read-modify-write on the same cache line
+class AtomicCounter
+{
+  std::atomic<long long> value{ 0 };
+
+public:
+  explicit AtomicCounter(size_t) {}
+
+  void Increment(size_t) { value.fetch_add(1, std::memory_order_relaxed); }
+  long long Read() { return value.load(std::memory_order_relaxed); }
+};
+
+// One shard per thread, summed on read. A shard is written only by its own thread, so an increment is a
+// plain load and store. With Padded each shard fills a whole cache line; without it neighbouring shards
+// share lines and every increment invalidates the other threads' copies (false sharing).
+template <bool Padded>
+class ShardedCounter
+{
+  static const size_t cacheLine = 64;
+
+  struct PlainShard
+  {
+    std::atomic<long long> value{ 0 };
+  };
+
+  struct PaddedShard
+  {
+    std::atomic<long long> value{ 0 };
+    char padding[cacheLine - sizeof(std::atomic<long long>)];
+  };
+
+  typename std::conditional<Padded, PaddedShard, PlainShard>::type* shards;
+  size_t count;
+
+public:
+  explicit ShardedCounter(size_t threads) : shards(new typename std::conditional<Padded, PaddedShard, PlainShard>::type[threads]), count(threads) {}
+  ShardedCounter(const ShardedCounter&) = delete;
+  ShardedCounter& operator=(const ShardedCounter&) = delete;
+  ~ShardedCounter() { delete[] shards; }
+
+  void Increment(size_t thread)
+  {
+    auto& value = shards[thread].value;
+    value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  long long Read()
+  {
+    long long sum = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+      sum += shards[i].value.load(std::memory_order_relaxed);
+    }
+    return sum;
+  }
+};
+
+// The assignment's workload with a counter in place of the global: the threads share one total of
+// totalIncrements, split as evenly as possible between them
+template <typename Counter>
+double RunCounterWorkload(Counter& counter, size_t threadCount, size_t totalIncrements)
+{
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+
+  for (size_t t = 0; t < threadCount; ++t)
+  {
+    const size_t increments = totalIncrements * (t + 1) / threadCount - totalIncrements * t / threadCount;
+    threads.emplace_back([&counter, t, increments] {
+      for (size_t i = 0; i < increments; ++i)
+      {
+        counter.Increment(t);
+      }
+    });
+  }
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename Counter>
+void ReportCounter(const std::string& name, size_t threadCount, size_t totalIncrements)
+{
+  Counter counter(threadCount);
+  const double seconds = RunCounterWorkload(counter, threadCount, totalIncrements);
+  const long long expected = static_cast<long long>(totalIncrements);
+  std::cout << "  " << name << ": " << counter.Read() << (counter.Read() == expected ? "" : " (WRONG)") << ", "
+    << expected / seconds << " increments/sec" << std::endl;
+}
+
+void BenchmarkCounters(size_t threadCount, size_t totalIncrements)
+{
+  std::cout << threadCount << " threads sharing " << totalIncrements << " increments:" << std::endl;
+  ReportCounter<MutexCounter>("mutex         ", threadCount, totalIncrements);
+  ReportCounter<AtomicCounter>("atomic        ", threadCount, totalIncrements);
+  ReportCounter<ShardedCounter<false>>("packed shards ", threadCount, totalIncrements);
+  ReportCounter<ShardedCounter<true>>("padded shards ", threadCount, totalIncrements);
+}
+
 int main()
 {
   std::vector<std::thread> threads;
@@ -25,5 +158,14 @@ int main()
 
   std::cout << "Global variable: " << global << std::endl;
 
+  BenchmarkCounters(10, 10000);
+
+  const size_t cores = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+  for (size_t threadCount = 1; threadCount < cores; threadCount *= 2)
+  {
+    BenchmarkCounters(threadCount, 10000000);
+  }
+  BenchmarkCounters(cores, 10000000);
+
   return 0;
 }
\ No newline at end of file
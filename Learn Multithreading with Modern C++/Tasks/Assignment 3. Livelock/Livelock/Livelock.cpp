@@ -1,5 +1,26 @@
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(_M_ARM) || defined(_M_ARM64)
+#include <intrin.h>
+#endif
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#pragma comment(lib, "Synchronization.lib")
+#elif defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 int x{ 0 };
 std::mutex mt;
@@ -14,6 +35,348 @@ void func() {
   }
 }
 
+// Tells the core we are spinning: saves power and lets a sibling hyperthread run
+inline void CpuRelax()
+{
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+  _mm_pause();
+#elif defined(_M_ARM) || defined(_M_ARM64)
+  __yield();
+#elif defined(__arm__) || defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// Sleeps while word == expected (returns at once if it already differs; may return spuriously), and wakes
+// threads sleeping on word. Without an OS primitive the wait degrades to a yield.
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words are plain 32-bit integers");
+
+inline void FutexWait(std::atomic<uint32_t>& word, uint32_t expected)
+{
+#ifdef _WIN32
+  WaitOnAddress(&word, &expected, sizeof(expected), INFINITE);
+#elif defined(__linux__)
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+  if (word.load(std::memory_order_relaxed) == expected)
+    std::this_thread::yield();
+#endif
+}
+
+inline void FutexWake(std::atomic<uint32_t>& word, bool all)
+{
+#ifdef _WIN32
+  if (all)
+    WakeByAddressAll(&word);
+  else
+    WakeByAddressSingle(&word);
+#elif defined(__linux__)
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, all ? INT32_MAX : 1, nullptr, nullptr, 0);
+#else
+  (void)word;
+  (void)all;
+#endif
+}
+
+// Exponential backoff: each Pause() spins twice as long as the last, up to a cap, and then reports that
+// spinning is no longer paying off so the caller can yield or sleep
+class Backoff
+{
+  static const unsigned maxSpins = 1024;
+  unsigned spins{ 1 };
+
+public:
+  bool Pause()
+  {
+    for (unsigned i = 0; i < spins; ++i)
+      CpuRelax();
+    if (spins == maxSpins)
+      return false;
+    spins *= 2;
+    return true;
+  }
+};
+
+// The locks below spin with backoff first. Once spinning stops paying off, Park = true sleeps on a futex
+// (WaitOnAddress on Windows); Park = false yields the time slice and keeps spinning. All of them are
+// BasicLockable, so they work with std::lock_guard.
+
+// Test-and-test-and-set: waiters spin on a plain load and only try the atomic exchange when the lock looks
+// free, so the cache line is not bounced while the lock is held. Not fair.
+template <bool Park>
+class TtasLock
+{
+  std::atomic<uint32_t> state{ 0 }; // 0 free, 1 held, 2 held and a thread may be asleep
+
+  bool TryAcquire()
+  {
+    uint32_t expected = 0;
+    return state.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed);
+  }
+
+public:
+  void lock()
+  {
+    Backoff backoff;
+    while (!(state.load(std::memory_order_relaxed) == 0 && TryAcquire())) {
+      if (backoff.Pause())
+        continue;
+      if (Park) {
+        // From here on the lock is always taken in the contended state, so its release wakes a sleeper
+        while (state.exchange(2, std::memory_order_acquire) != 0)
+          FutexWait(state, 2);
+        return;
+      }
+      std::this_thread::yield();
+    }
+  }
+
+  void unlock()
+  {
+    if (!Park)
+      state.store(0, std::memory_order_release);
+    else if (state.exchange(0, std::memory_order_release) == 2)
+      FutexWake(state, false);
+  }
+};
+
+// Ticket lock: threads take numbers and are served in order, so it is FIFO-fair. Waiters back off in
+// proportion to how far back in the queue they are.
+template <bool Park>
+class TicketLock
+{
+  std::atomic<uint32_t> next{ 0 };
+  char padding[64 - sizeof(std::atomic<uint32_t>)]; // keeps arrivals off the line the holder's release writes
+  std::atomic<uint32_t> serving{ 0 };
+  std::atomic<uint32_t> sleepers{ 0 };
+
+public:
+  void lock()
+  {
+    const uint32_t ticket = next.fetch_add(1, std::memory_order_relaxed);
+    for (unsigned rounds = 0;; ++rounds) {
+      const uint32_t now = serving.load(std::memory_order_acquire);
+      if (now == ticket)
+        return;
+      if (rounds < 64) {
+        for (uint32_t i = 0, spins = 32 * (ticket - now); i < spins; ++i)
+          CpuRelax();
+      }
+      else if (Park) {
+        // sleepers is raised before the futex rechecks serving, and unlock() raises serving before reading
+        // sleepers, so one of the two always sees the other
+        sleepers.fetch_add(1);
+        FutexWait(serving, now);
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+      }
+      else
+        std::this_thread::yield();
+    }
+  }
+
+  void unlock()
+  {
+    // Only the holder writes serving
+    const uint32_t following = serving.load(std::memory_order_relaxed) + 1;
+    if (!Park) {
+      serving.store(following, std::memory_order_release);
+      return;
+    }
+    serving.store(following);
+    if (sleepers.load() != 0)
+      FutexWake(serving, true);
+  }
+};
+
+// A waiter's place in an McsLock queue; it spins on its own node, not on the shared lock word
+struct McsNode
+{
+  std::atomic<McsNode*> next{ nullptr };
+  std::atomic<uint32_t> waiting{ 0 }; // 0 lock handed over, 1 spinning, 2 asleep
+};
+
+// MCS queue lock: FIFO like the ticket lock, but every waiter spins on its own cache line and a release
+// touches only the successor's node. lock(node)/unlock(node) take a caller-owned node; lock()/unlock() use
+// one node per thread, so through them a thread holds at most one McsLock at a time.
+template <bool Park>
+class McsLock
+{
+  std::atomic<McsNode*> tail{ nullptr };
+
+  static McsNode& ThreadNode()
+  {
+    thread_local McsNode node;
+    return node;
+  }
+
+public:
+  void lock(McsNode& node)
+  {
+    node.next.store(nullptr, std::memory_order_relaxed);
+    node.waiting.store(1, std::memory_order_relaxed);
+    McsNode* previous = tail.exchange(&node, std::memory_order_acq_rel);
+    if (previous == nullptr)
+      return;
+    previous->next.store(&node, std::memory_order_release);
+
+    Backoff backoff;
+    while (node.waiting.load(std::memory_order_acquire) != 0) {
+      if (backoff.Pause())
+        continue;
+      uint32_t spinning = 1;
+      if (Park && node.waiting.compare_exchange_strong(spinning, 2, std::memory_order_acquire)) {
+        while (node.waiting.load(std::memory_order_acquire) == 2)
+          FutexWait(node.waiting, 2);
+      }
+      else
+        std::this_thread::yield();
+    }
+  }
+
+  void unlock(McsNode& node)
+  {
+    McsNode* successor = node.next.load(std::memory_order_acquire);
+    if (successor == nullptr) {
+      McsNode* expected = &node;
+      if (tail.compare_exchange_strong(expected, nullptr, std::memory_order_release, std::memory_order_relaxed))
+        return;
+      // A thread has joined the queue but not linked itself yet
+      Backoff backoff;
+      while ((successor = node.next.load(std::memory_order_acquire)) == nullptr)
+        if (!backoff.Pause())
+          std::this_thread::yield();
+    }
+    if (successor->waiting.exchange(0, std::memory_order_release) == 2)
+      FutexWake(successor->waiting, false);
+  }
+
+  void lock() { lock(ThreadNode()); }
+  void unlock() { unlock(ThreadNode()); }
+};
+
+// Jain's fairness index of per-thread counts: 1 when all threads got the same share, 1/n when one got all
+double JainFairness(const std::vector<uint64_t>& counts)
+{
+  double sum = 0, squares = 0;
+  for (uint64_t count : counts) {
+    sum += static_cast<double>(count);
+    squares += static_cast<double>(count) * count;
+  }
+  return squares == 0 ? 1 : sum * sum / (counts.size() * squares);
+}
+
+struct LockRun
+{
+  double perSecond{ 0 };
+  double fairness{ 0 };
+  double acquisitionsPerFlip{ 0 }; // livelock scenario only
+  bool consistent{ true };
+};
+
+// Starts `threads` copies of body(t, counts[t]) together, stops them after `seconds` and returns the time
+// they actually ran
+template <typename Body>
+double RunFor(size_t threads, double seconds, std::vector<uint64_t>& counts, std::atomic<bool>& stop, Body body)
+{
+  std::atomic<size_t> ready{ 0 };
+  std::atomic<bool> go{ false };
+  counts.assign(threads, 0);
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      ++ready;
+      while (!go.load(std::memory_order_acquire))
+        std::this_thread::yield();
+      body(t, counts[t]);
+    });
+  }
+  while (ready.load() != threads)
+    std::this_thread::yield();
+
+  const auto start = std::chrono::steady_clock::now();
+  go.store(true, std::memory_order_release);
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop.store(true, std::memory_order_relaxed);
+  for (auto& worker : workers)
+    worker.join();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// The assignment's pattern as a workload: two threads take turns flipping x, and each finds out whether it
+// is its turn by taking the lock and looking. Every acquisition that finds the other thread's turn is
+// wasted, so an unfair lock that keeps handing itself back to the same thread approaches livelock.
+template <typename Lock>
+LockRun RunLivelockScenario(double seconds)
+{
+  Lock lock;
+  int turn = 0;
+  std::atomic<bool> stop{ false };
+  std::vector<uint64_t> flips;
+  std::vector<uint64_t> acquisitions(2);
+  const double elapsed = RunFor(2, seconds, flips, stop, [&](size_t t, uint64_t& myFlips) {
+    uint64_t tries = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+      std::lock_guard<Lock> guard(lock);
+      ++tries;
+      if (turn == static_cast<int>(t)) {
+        turn = 1 - turn;
+        ++myFlips;
+      }
+    }
+    acquisitions[t] = tries;
+  });
+
+  LockRun run;
+  const uint64_t total = flips[0] + flips[1];
+  run.perSecond = total / elapsed;
+  run.fairness = JainFairness(flips);
+  run.acquisitionsPerFlip = total ? static_cast<double>(acquisitions[0] + acquisitions[1]) / total : 0;
+  run.consistent = flips[0] >= flips[1] && flips[0] - flips[1] <= 1;
+  return run;
+}
+
+// Many threads, each repeatedly taking the lock for a tiny critical section
+template <typename Lock>
+LockRun RunShortSections(size_t threads, double seconds)
+{
+  Lock lock;
+  uint64_t shared = 0;
+  std::atomic<bool> stop{ false };
+  std::vector<uint64_t> counts;
+  const double elapsed = RunFor(threads, seconds, counts, stop, [&](size_t, uint64_t& mine) {
+    uint64_t local = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+      lock.lock();
+      ++shared;
+      lock.unlock();
+      ++local;
+    }
+    mine = local;
+  });
+
+  LockRun run;
+  uint64_t total = 0;
+  for (uint64_t count : counts)
+    total += count;
+  run.perSecond = total / elapsed;
+  run.fairness = JainFairness(counts);
+  run.consistent = total == shared;
+  return run;
+}
+
+template <typename Lock>
+void BenchmarkLock(const std::string& name, size_t manyThreads, double seconds)
+{
+  const LockRun livelock = RunLivelockScenario<Lock>(seconds);
+  const LockRun two = RunShortSections<Lock>(2, seconds);
+  const LockRun many = RunShortSections<Lock>(manyThreads, seconds);
+  std::cout << std::left << std::setw(14) << name << std::right << std::setprecision(3)
+    << std::setw(11) << livelock.perSecond << std::setw(10) << livelock.acquisitionsPerFlip
+    << std::setw(12) << two.perSecond << std::setw(7) << two.fairness
+    << std::setw(12) << many.perSecond << std::setw(7) << many.fairness
+    << ((livelock.consistent && two.consistent && many.consistent) ? "" : "  INCONSISTENT") << std::endl;
+}
+
 int main()
 {
   std::thread thr1{ func };
@@ -21,4 +384,17 @@ int main()
 
   thr1.join();
   thr2.join();
-}
\ No newline at end of file
+
+  const size_t cores = std::thread::hardware_concurrency();
+  const size_t manyThreads = cores > 4 ? cores : 4;
+  const double seconds = 0.2;
+  std::cout << "lock          | livelock: flips/s  acq/flip | 2 threads: acq/s  fair | "
+    << manyThreads << " threads: acq/s  fair" << std::endl;
+  BenchmarkLock<std::mutex>("std::mutex", manyThreads, seconds);
+  BenchmarkLock<TtasLock<false>>("ttas", manyThreads, seconds);
+  BenchmarkLock<TtasLock<true>>("ttas+futex", manyThreads, seconds);
+  BenchmarkLock<TicketLock<false>>("ticket", manyThreads, seconds);
+  BenchmarkLock<TicketLock<true>>("ticket+futex", manyThreads, seconds);
+  BenchmarkLock<McsLock<false>>("mcs", manyThreads, seconds);
+  BenchmarkLock<McsLock<true>>("mcs+futex", manyThreads, seconds);
+}